@@ -1,150 +1,864 @@
-inline int palette(double pos, double rateOfChange, int colour) { //pos between 1 and 0
-    pos = log(pos);
-    if (colour == 0) { return (int)round(127.5 * sin(rateOfChange * 2 * M_PI * pos + 1) + 127.5); }
-    if (colour == 1) { return (int)round(127.5 * sin(rateOfChange * 2 * M_PI * pos + (2.0 / 3.0) * M_PI + 1) + 127.5); }
-    if (colour == 2) { return (int)round(127.5 * sin(rateOfChange * 2 * M_PI * pos + (4.0 / 3.0) * M_PI + 1) + 127.5); }
-    return 0;
-}
-
 typedef struct {
     double real;
     double imag;
 } complexDouble;
 
-__kernel void juliaKernel(__global uint* pixelArr, int screenWidth, int screenHeight, double zoom,
-    double positionX, double positionY, int maxIterations, __global const int* workQueue, __global int* globalIndex, int colouringScheme, double cX, double cY) {
-    if (colouringScheme == 0) {
-        int i = get_global_id(0);
-        int totalPixels = screenWidth * screenHeight;
-        int idx = atomic_inc(globalIndex);
-        double temp;
+// same layout as floatExp in float exp.h: mantissa * 2^exponent, with mantissa 0 or 0.5 <= |mantissa| < 1
+typedef struct {
+    double mantissa;
+    int exponent;
+} floatExp;
+
+// value in units of 2^unitExponent, as floatExp::scaled on the host
+inline double floatExpScaled(floatExp value, int unitExponent) {
+    return ldexp(value.mantissa, value.exponent - unitExponent);
+}
+
+// precision of the escape-time iteration in juliaPixel: the host builds this program a second time with -D FLOAT_TIER
+// and renders with that build's juliaKernel and marianiSilverKernel while float resolves every pixel of the view.
+// When it only resolves some, the float build's juliaKernel renders the tiles inside floatRect and the double build the rest.
+#ifdef FLOAT_TIER
+typedef float tierReal;
+#define FLOAT_BUILD 1
+#else
+typedef double tierReal;
+#define FLOAT_BUILD 0
+#endif
+
+typedef struct {
+    tierReal real;
+    tierReal imag;
+} complexTier;
+
+// what the colour pass needs of a finished pixel, layout matches gBufferPixel in cpu renderer.h
+typedef struct {
+    float smoothIteration; // iteration + 2 - log2(log|z|^2)
+    float magnitude; // |z|^2 where the pixel stopped
+    float normalAngle; // arg(z/der), the direction the lighting scheme shades with
+    int interior; // 1 if the pixel reached maxIterations or was caught by the period check
+} gBufferPixel;
+
+// iteration state of one pixel, so that raising maxIterations on an unchanged view can carry on from where it stopped
+// iteration: final count if the pixel escaped, the old maxIterations if it hit the cap, -1 if the period check caught it
+// layout matches pixelState in cpu renderer.h
+typedef struct {
+    double zReal;
+    double zImag;
+    double derReal;
+    double derImag;
+    double zOldReal;
+    double zOldImag;
+    int iteration;
+} pixelState;
+
+// one entry of the BLA table built on the host: d = A d + B dc skips 2^level iterations while |d| < radius
+// layout matches blaStep in bla table.h
+typedef struct {
+    complexDouble a;
+    complexDouble b; // 0 for julia sets
+    double radius; // 0 if it is below what a double holds
+    int radiusExponent; // radius >= 2^radiusExponent, INT_MIN for a step that is never valid
+} blaStep;
+
+#define EXTENDED_RANGE_EXPONENT -960 // views deeper than doubles reach keep d scaled while it is below 2^EXTENDED_RANGE_EXPONENT
+#define GLITCH_TOLERANCE 1e-6 // a perturbed pixel is glitched once |z|^2 < GLITCH_TOLERANCE |Z|^2, matches glitchTolerance in cpu renderer.h
+
+#define STATE_NONE 0 // don't keep state
+#define STATE_WRITE 1 // iterate from scratch and store the state
+#define STATE_RESUME 2 // continue the stored state of a render with previousMaxIterations
+
+#define PALETTE_SIZE 1024 // entries per palette period, matches paletteSize in palette.h
+
+#define TILE_SIZE 8 // tiles are TILE_SIZE x TILE_SIZE pixels, one work group renders one tile at a time
+#define TILE_PIXELS (TILE_SIZE * TILE_SIZE)
+#define SUPER_TILE 8 // tiles are walked in Z-order inside SUPER_TILE x SUPER_TILE blocks of tiles
+#define FLAT_RUN 4 // this many escaped pixels in a row with identical G-buffer entries mean their coordinates collapsed
+
+#define MS_BLOCK_SIZE 64 // side of the first Mariani-Silver pass's rectangles, matches marianiSilverBlockSize in cpu renderer.h
+#define MS_SPLIT_SIZE 8 // rectangles this narrow or short are iterated in full instead of being split again
+
+// keeps the even bits of v, packed together
+inline int compactBits(int v) {
+    v &= 0x5555;
+    v = (v | (v >> 1)) & 0x3333;
+    v = (v | (v >> 2)) & 0x0F0F;
+    v = (v | (v >> 4)) & 0x00FF;
+    return v;
+}
+
+// tile index -> tile coordinate, blocks in row-major order and Morton order inside each block
+inline int2 tileCoordinate(int tile, int blocksX) {
+    int block = tile / (SUPER_TILE * SUPER_TILE);
+    int local = tile % (SUPER_TILE * SUPER_TILE);
+    return (int2)((block % blocksX) * SUPER_TILE + compactBits(local), (block / blocksX) * SUPER_TILE + compactBits(local >> 1));
+}
+
+// G-buffer entry of a pixel that stopped at iteration with z and der = dz/dc (dz/dz0 for julia sets)
+inline gBufferPixel shadePixel(int iteration, int maxIterations, complexDouble z, complexDouble der) {
+    gBufferPixel result = { 0, 0, 0, 1 };
+    if (iteration == maxIterations) {
+        return result;
+    }
+    double magnitude = z.real * z.real + z.imag * z.imag;
+    result.smoothIteration = (float)(iteration + 2 - log(log(magnitude)) / log((double)2));
+    result.magnitude = (float)magnitude;
+    // arg(z/der) = arg(z*conj(der))
+    result.normalAngle = (float)atan2(z.imag * der.real - z.real * der.imag, z.real * der.real + z.imag * der.imag);
+    result.interior = 0;
+    return result;
+}
+
+// finalIteration is set to the iteration count, maxIterations for interior pixels
+inline gBufferPixel juliaPixel(int x, int y, int screenWidth, int screenHeight, double zoom,
+    double positionX, double positionY, int maxIterations, double cX, double cY,
+    __global pixelState* state, int stateMode, int previousMaxIterations, double cycleTolerance, int* cyclePixels, int* finalIteration) {
+    double aspectRatio = (double)screenWidth / screenHeight;
+    int iteration = 0;
+    complexTier z = { ((double)x / screenWidth - 0.5) * zoom * aspectRatio + positionX, ((double)y / screenHeight - 0.5) * zoom + positionY };
+    complexTier zOld = { 0,0 };
+    const complexTier complexPoint = { cX, cY };
+    int boundedThreshold = 8 * 8;
+    tierReal cycleTolerance2 = cycleTolerance * cycleTolerance;
+    tierReal temp;
+
+    complexTier dc = { 0,0 }; // der is dz/dz0, c is fixed
+    complexTier der = { 1,0 };
+    int pixelIndex = y * screenWidth + x;
+    bool finished = false;
+    bool cycled = false;
+
+    if (stateMode == STATE_RESUME) {
+        pixelState stored = state[pixelIndex];
+        z.real = stored.zReal;
+        z.imag = stored.zImag;
+        der.real = stored.derReal;
+        der.imag = stored.derImag;
+        zOld.real = stored.zOldReal;
+        zOld.imag = stored.zOldImag;
+        if (stored.iteration < 0) { // already known to be periodic
+            iteration = maxIterations;
+            finished = true;
+            cycled = true;
+        }
+        else if (stored.iteration < previousMaxIterations) { // already escaped
+            iteration = stored.iteration;
+            finished = true;
+        }
+        else { // stopped at the old cap, undo the increment that failed the loop condition and carry on
+            iteration = stored.iteration - 1;
+        }
+    }
+
+    // stops when abs(z) >= sqrt(boundedThreshold), at which point we estimate that z is unbounded at complexPoint, so that complexPoint is not in the mandelbrot set
+    while (!finished && z.real * z.real + z.imag * z.imag < boundedThreshold && ++iteration < maxIterations) {
+        // der = der*2*z + dc, always kept so the colour pass can light the pixel
+        temp = (der.real * z.imag + der.imag * z.real) * 2 + dc.imag;
+        der.real = (der.real * z.real - der.imag * z.imag) * 2 + dc.real;
+        der.imag = temp;
+
+        // z = z^2 + c
+        temp = 2 * z.real * z.imag + complexPoint.imag;
+        z.real = z.real * z.real - z.imag * z.imag + complexPoint.real;
+        z.imag = temp;
+
+        // Brent-style cycle detection: compare against the orbit point at the last power of two iteration,
+        // so any cycle is caught once the window has grown past its length
+        tierReal dReal = z.real - zOld.real;
+        tierReal dImag = z.imag - zOld.imag;
+        if (dReal * dReal + dImag * dImag <= cycleTolerance2) {
+            iteration = maxIterations;
+            cycled = true;
+            (*cyclePixels)++;
+            break;
+        }
+
+        if ((iteration & (iteration - 1)) == 0) {
+            zOld.real = z.real;
+            zOld.imag = z.imag;
+        }
+    }
+
+    if (stateMode != STATE_NONE) {
+        pixelState stored = { z.real, z.imag, der.real, der.imag, zOld.real, zOld.imag, cycled ? -1 : iteration };
+        state[pixelIndex] = stored;
+    }
+    *finalIteration = iteration;
+    return shadePixel(iteration, maxIterations, (complexDouble){ z.real, z.imag }, (complexDouble){ der.real, der.imag });
+}
+
+// rect is (x, y, width, height)
+inline bool insideRect(int4 rect, int x, int y) {
+    return x >= rect.x && x < rect.x + rect.z && y >= rect.y && y < rect.y + rect.w;
+}
+
+// globalIndex[0] is the next tile (or pixel, or rectangle) to claim and [1] the generation this frame renders, INT_MAX for
+// a frame that must finish; cancelGeneration holds the newest view generation the host has asked for. The compute kernels
+// stop claiming work once the frame is older than the view, and the host drops it. The host writes cancelGeneration while
+// they run, and nothing else shares its buffer: with SVM_CANCEL it is fine-grained SVM and an atomic store they are sure
+// to see; otherwise it is a fill from another queue, which they may see late or not at all, and then simply finish the frame.
+inline bool frameAbandoned(__global const int* globalIndex, __global int* cancelGeneration) {
+#ifdef SVM_CANCEL
+    int cancelledBelow = atomic_load_explicit((volatile __global atomic_int*)cancelGeneration, memory_order_relaxed, memory_scope_all_svm_devices);
+#else
+    int cancelledBelow = *(volatile __global int*)cancelGeneration;
+#endif
+    return globalIndex[1] < cancelledBelow;
+}
+
+// only renderRect is rendered, the whole frame unless a pan just exposed a strip of it
+// iterationCounts is NULL unless a zoom step reuses pixels, which reprojectKernel marked with counts >= 0
+// pixels in copyRect are skipped, the mirror kernel fills them in afterwards
+// interiorCounts[1] counts the pixels finished early by cycle detection, [0] is the mandelbrot kernel's cardioid/bulb count
+// tileClaiming == 1: each work group claims a whole tile with one atomic, walking the tiles in Z-order so that
+// neighbouring lanes render neighbouring pixels. tileClaiming == 0: every work item claims single pixels in scanline order.
+// the float build renders only the tiles (pixels, without tile claiming) entirely inside floatRect, the double build only the others
+// with tileList (tile claiming only), just the tiles detectCollapseKernel listed in it are rendered, whichever side of floatRect
+__kernel void juliaKernel(__global gBufferPixel* gBuffer, int screenWidth, int screenHeight, double zoom,
+    double positionX, double positionY, int maxIterations, __global int* globalIndex, __global int* cancelGeneration, int tileClaiming, double cX, double cY,
+    __global pixelState* state, int stateMode, int previousMaxIterations, int4 copyRect, double cycleTolerance, __global int* interiorCounts,
+    int4 renderRect, __global const int* iterationCounts, int4 floatRect, __global const int* tileList) {
+    int cyclePixels = 0;
+    int finalIteration;
+    if (tileClaiming == 1) {
+        __local int claimedTile;
+        int tilesX = (renderRect.z + TILE_SIZE - 1) / TILE_SIZE;
+        int tilesY = (renderRect.w + TILE_SIZE - 1) / TILE_SIZE;
+        int blocksX = (tilesX + SUPER_TILE - 1) / SUPER_TILE;
+        int blocksY = (tilesY + SUPER_TILE - 1) / SUPER_TILE;
+        int totalTiles = tileList != NULL ? tileList[0] : blocksX * blocksY * SUPER_TILE * SUPER_TILE;
+
+        while (1) {
+            if (get_local_id(0) == 0) {
+                claimedTile = frameAbandoned(globalIndex, cancelGeneration) ? INT_MAX : atomic_inc(globalIndex);
+            }
+            barrier(CLK_LOCAL_MEM_FENCE);
+            int tile = claimedTile;
+            barrier(CLK_LOCAL_MEM_FENCE);
+            if (tile >= totalTiles) { break; }
+            if (tileList != NULL) { tile = tileList[1 + tile]; }
+
+            int2 tileXY = tileCoordinate(tile, blocksX);
+            int tileX = renderRect.x + tileXY.x * TILE_SIZE;
+            int tileY = renderRect.y + tileXY.y * TILE_SIZE;
+            int lastX = min(tileX + TILE_SIZE, renderRect.x + renderRect.z) - 1;
+            int lastY = min(tileY + TILE_SIZE, renderRect.y + renderRect.w) - 1;
+            if (tileList == NULL && (insideRect(floatRect, tileX, tileY) && insideRect(floatRect, lastX, lastY)) != FLOAT_BUILD) { continue; } // the other build's tile
+            for (int p = get_local_id(0); p < TILE_PIXELS; p += get_local_size(0)) {
+                int x = tileX + p % TILE_SIZE;
+                int y = tileY + p / TILE_SIZE;
+                if (insideRect(renderRect, x, y) && !insideRect(copyRect, x, y) && (iterationCounts == 0 || iterationCounts[y * screenWidth + x] < 0)) {
+                    gBuffer[y * screenWidth + x] = juliaPixel(x, y, screenWidth, screenHeight, zoom, positionX, positionY, maxIterations, cX, cY, state, stateMode, previousMaxIterations, cycleTolerance, &cyclePixels, &finalIteration);
+                }
+            }
+        }
+    }
+    else {
+        int totalPixels = renderRect.z * renderRect.w;
+        int idx = frameAbandoned(globalIndex, cancelGeneration) ? totalPixels : atomic_inc(globalIndex);
 
         while (idx < totalPixels) {
-            int pixelIndex = workQueue[idx];
-            int x = pixelIndex % screenWidth;
-            int y = pixelIndex / screenHeight;
-            double aspectRatio = (double)screenWidth / screenHeight;
-            int iteration = 0;
-            complexDouble z = { ((double)x / screenWidth - 0.5) * zoom * aspectRatio + positionX, ((double)y / screenWidth - 0.5) * zoom + positionY };
-            complexDouble zOld = { 0,0 };
-            const complexDouble complexPoint = { cX, cY };
-            int boundedThreshold = 8 * 8;
-            int period = 0;
-
-            // stops when abs(z) >= sqrt(boundedThreshold), at which point we estimate that z is unbounded at complexPoint, so that complexPoint is not in the mandelbrot set
-            while (z.real * z.real + z.imag * z.imag < boundedThreshold && ++iteration < maxIterations) {
-                // z = z^2 + c
-                temp = 2 * z.real * z.imag + complexPoint.imag;
-                z.real = z.real * z.real - z.imag * z.imag + complexPoint.real;
-                z.imag = temp;
+            int x = renderRect.x + idx % renderRect.z;
+            int y = renderRect.y + idx / renderRect.z;
+            if (!insideRect(copyRect, x, y) && insideRect(floatRect, x, y) == FLOAT_BUILD && (iterationCounts == 0 || iterationCounts[y * screenWidth + x] < 0)) {
+                gBuffer[y * screenWidth + x] = juliaPixel(x, y, screenWidth, screenHeight, zoom, positionX, positionY, maxIterations, cX, cY, state, stateMode, previousMaxIterations, cycleTolerance, &cyclePixels, &finalIteration);
+            }
+            idx = frameAbandoned(globalIndex, cancelGeneration) ? totalPixels : atomic_inc(globalIndex);
+        }
+    }
 
-                if (z.real == zOld.real && z.imag == zOld.imag) {
-                    iteration = maxIterations;
+    if (cyclePixels > 0) { atomic_add(&interiorCounts[1], cyclePixels); }
+}
+
+// longest step of the BLA table that starts at iteration, is valid for d and is no longer than maxLength; 0 if there is none.
+// Level k holds the steps of length 2^k starting at 1, 1 + 2^k, 1 + 2 * 2^k, ..., (referenceLength - 2) >> k of them.
+inline int blaLookup(__global const blaStep* blaTable, int blaLevels, int referenceLength, int iteration, complexDouble d, int maxLength, blaStep* found) {
+    int index = iteration - 1;
+    int count = referenceLength - 2;
+    double magnitude = d.real * d.real + d.imag * d.imag;
+    int length = 0;
+    int start = 0;
+    for (int level = 1; level <= blaLevels && index >= 0; level++) {
+        int i = index >> level;
+        // a longer step begins with the shorter one, so it can't be valid where that wasn't
+        if ((i << level) != index || i >= count >> level || (1 << level) > maxLength) { break; }
+        blaStep step = blaTable[start + i];
+        if (magnitude >= step.radius * step.radius) { break; }
+        *found = step;
+        length = 1 << level;
+        start += count >> level;
+    }
+    return length;
+}
+
+// blaLookup for d in units of 2^exponent, deeper than doubles reach: compares exponents instead of magnitudes, which
+// turns down steps whose radius is less than about 4 |d| but works at any depth
+inline int blaLookupExtended(__global const blaStep* blaTable, int blaLevels, int referenceLength, int iteration, complexDouble d, int exponent, int maxLength, blaStep* found) {
+    int index = iteration - 1;
+    int count = referenceLength - 2;
+    double largest = fmax(fabs(d.real), fabs(d.imag));
+    // |d| < 2^bound
+    int bound = largest == 0 ? INT_MIN + 1 : ilogb(largest) + 2 + exponent;
+    int length = 0;
+    int start = 0;
+    for (int level = 1; level <= blaLevels && index >= 0; level++) {
+        int i = index >> level;
+        if ((i << level) != index || i >= count >> level || (1 << level) > maxLength) { break; }
+        blaStep step = blaTable[start + i];
+        if (bound > step.radiusExponent) { break; }
+        *found = step;
+        length = 1 << level;
+        start += count >> level;
+    }
+    return length;
+}
+
+// scales value below 1 by a power of two that is added to exponent, so a BLA step can't overflow it; returns the shift
+inline int normalise(complexDouble* value, int* exponent) {
+    double largest = fmax(fabs(value->real), fabs(value->imag));
+    if (largest < 1) { return 0; }
+    int shift = ilogb(largest) + 1;
+    value->real = ldexp(value->real, -shift);
+    value->imag = ldexp(value->imag, -shift);
+    *exponent += shift;
+    return shift;
+}
+
+// adds count to a 64-bit counter kept as two uints, low word first, using 32-bit atomics only
+inline void addSkippedIterations(__global uint* skippedIterations, ulong count) {
+    uint low = (uint)count;
+    uint old = atomic_add(&skippedIterations[0], low);
+    uint high = (uint)(count >> 32) + (old + low < old ? 1 : 0);
+    if (high > 0) { atomic_add(&skippedIterations[1], high); }
+}
+
+// Pauldelbrot's criterion: z = Z + d has nearly cancelled to 0, so the rounding error d carries relative to Z is huge
+// relative to z, and the rest of the pixel's orbit can't be trusted. Another reference point near the pixel fixes it.
+inline bool isGlitched(complexDouble z, complexDouble reference) {
+    return z.real * z.real + z.imag * z.imag < GLITCH_TOLERANCE * (reference.real * reference.real + reference.imag * reference.imag);
+}
+
+// perturbed iteration of pixel (x, y) around the reference orbit Z computed on the host: with z = Z_n + d,
+// d = (2 Z_n + d) d stays small enough for doubles however deep the view is. offset is the view centre minus the
+// reference point Z_0. Past the end of the orbit (the reference escaped first) the pixel carries on with plain z^2 + c.
+// Wherever blaTable has a step valid for d the pixel takes it instead of iterating, adding the iterations it skipped to skipped.
+// With detectGlitches the pixel stops as soon as isGlitched catches it or it outlives the orbit, and sets glitched.
+inline gBufferPixel juliaPerturbationPixel(int x, int y, int screenWidth, int screenHeight, double zoom, int maxIterations, double cX, double cY,
+    __global const complexDouble* referenceOrbit, int referenceLength, double offsetX, double offsetY, __global const blaStep* blaTable, int blaLevels, ulong* skipped, bool detectGlitches, bool* glitched) {
+    double aspectRatio = (double)screenWidth / screenHeight;
+    int iteration = 0;
+    complexDouble d = { ((double)x / screenWidth - 0.5) * zoom * aspectRatio + offsetX, ((double)y / screenHeight - 0.5) * zoom + offsetY };
+    complexDouble z = { referenceOrbit[0].real + d.real, referenceOrbit[0].imag + d.imag };
+    complexDouble der = { 1,0 };
+    int boundedThreshold = 8 * 8;
+    double temp;
+
+    while (z.real * z.real + z.imag * z.imag < boundedThreshold && ++iteration < maxIterations) {
+        blaStep skip;
+        int length = iteration < referenceLength ? blaLookup(blaTable, blaLevels, referenceLength, iteration - 1, d, maxIterations - iteration, &skip) : 0;
+        if (length > 0) {
+            // d = A d and der = A der, straight to the end of the step
+            temp = skip.a.real * d.imag + skip.a.imag * d.real;
+            d.real = skip.a.real * d.real - skip.a.imag * d.imag;
+            d.imag = temp;
+            temp = skip.a.real * der.imag + skip.a.imag * der.real;
+            der.real = skip.a.real * der.real - skip.a.imag * der.imag;
+            der.imag = temp;
+            iteration += length - 1;
+            z.real = referenceOrbit[iteration].real + d.real;
+            z.imag = referenceOrbit[iteration].imag + d.imag;
+            *skipped += length;
+            if (detectGlitches && isGlitched(z, referenceOrbit[iteration])) {
+                *glitched = true;
+                break;
+            }
+            continue;
+        }
+
+        // der = der*2*z
+        temp = (der.real * z.imag + der.imag * z.real) * 2;
+        der.real = (der.real * z.real - der.imag * z.imag) * 2;
+        der.imag = temp;
+
+        if (iteration < referenceLength) {
+            // d = (2 Z + d) d, then z = Z_next + d
+            complexDouble reference = referenceOrbit[iteration - 1];
+            double sumReal = 2 * reference.real + d.real;
+            double sumImag = 2 * reference.imag + d.imag;
+            temp = sumReal * d.imag + sumImag * d.real;
+            d.real = sumReal * d.real - sumImag * d.imag;
+            d.imag = temp;
+            reference = referenceOrbit[iteration];
+            z.real = reference.real + d.real;
+            z.imag = reference.imag + d.imag;
+            if (detectGlitches && isGlitched(z, reference)) {
+                *glitched = true;
+                break;
+            }
+        }
+        else {
+            if (detectGlitches) { //the reference escaped first, from here on the pixel is only as precise as a double
+                *glitched = true;
+                break;
+            }
+            temp = 2 * z.real * z.imag + cY;
+            z.real = z.real * z.real - z.imag * z.imag + cX;
+            z.imag = temp;
+        }
+    }
+    return shadePixel(iteration, maxIterations, z, der);
+}
+
+// juliaPerturbationPixel for views deeper than doubles reach: zoom and offset come in units of 2^scaleExponent, and d is
+// kept in units of 2^exponent, below 1, until it grows past 2^EXTENDED_RANGE_EXPONENT; from there on the pixel carries on
+// in plain doubles. der keeps an exponent of its own throughout, shading only needs its direction.
+inline gBufferPixel juliaExtendedPixel(int x, int y, int screenWidth, int screenHeight, double zoom, int maxIterations, double cX, double cY,
+    __global const complexDouble* referenceOrbit, int referenceLength, double offsetX, double offsetY,
+    __global const blaStep* blaTable, int blaLevels, int scaleExponent, ulong* skipped, bool detectGlitches, bool* glitched) {
+    double aspectRatio = (double)screenWidth / screenHeight;
+    int exponent = scaleExponent;
+    bool scaled = true;
+    int iteration = 0;
+    complexDouble d = { ((double)x / screenWidth - 0.5) * zoom * aspectRatio + offsetX, ((double)y / screenHeight - 0.5) * zoom + offsetY };
+    normalise(&d, &exponent);
+    complexDouble z = { referenceOrbit[0].real + ldexp(d.real, exponent), referenceOrbit[0].imag + ldexp(d.imag, exponent) };
+    complexDouble der = { 1,0 };
+    int derExponent = 0;
+    int boundedThreshold = 8 * 8;
+    double temp;
+
+    while (z.real * z.real + z.imag * z.imag < boundedThreshold && ++iteration < maxIterations) {
+        blaStep skip;
+        int length = 0;
+        if (iteration < referenceLength) {
+            length = scaled ? blaLookupExtended(blaTable, blaLevels, referenceLength, iteration - 1, d, exponent, maxIterations - iteration, &skip)
+                : blaLookup(blaTable, blaLevels, referenceLength, iteration - 1, d, maxIterations - iteration, &skip);
+        }
+        if (length > 0) {
+            // d = A d and der = A der, straight to the end of the step
+            temp = skip.a.real * d.imag + skip.a.imag * d.real;
+            d.real = skip.a.real * d.real - skip.a.imag * d.imag;
+            d.imag = temp;
+            temp = skip.a.real * der.imag + skip.a.imag * der.real;
+            der.real = skip.a.real * der.real - skip.a.imag * der.imag;
+            der.imag = temp;
+            iteration += length - 1;
+            *skipped += length;
+        }
+        else {
+            // der = der*2*z
+            temp = (der.real * z.imag + der.imag * z.real) * 2;
+            der.real = (der.real * z.real - der.imag * z.imag) * 2;
+            der.imag = temp;
+
+            if (iteration < referenceLength) {
+                // d = (2 Z + d) d, in units of 2^exponent while scaled
+                complexDouble reference = referenceOrbit[iteration - 1];
+                double sumReal = 2 * reference.real + (scaled ? ldexp(d.real, exponent) : d.real);
+                double sumImag = 2 * reference.imag + (scaled ? ldexp(d.imag, exponent) : d.imag);
+                temp = sumReal * d.imag + sumImag * d.real;
+                d.real = sumReal * d.real - sumImag * d.imag;
+                d.imag = temp;
+            }
+            else {
+                if (detectGlitches) { //the reference escaped first, from here on the pixel is only as precise as a double
+                    *glitched = true;
                     break;
                 }
+                temp = 2 * z.real * z.imag + cY;
+                z.real = z.real * z.real - z.imag * z.imag + cX;
+                z.imag = temp;
+            }
+        }
+        normalise(&der, &derExponent);
+        if (iteration >= referenceLength) { continue; }
 
-                if (period++ > 50) {
-                    period = 0;
-                    zOld.real = z.real;
-                    zOld.imag = z.imag;
-                }
+        if (scaled) {
+            normalise(&d, &exponent);
+            double largest = fmax(fabs(d.real), fabs(d.imag));
+            if (largest != 0 && ilogb(largest) + exponent >= EXTENDED_RANGE_EXPONENT) {
+                d.real = ldexp(d.real, exponent);
+                d.imag = ldexp(d.imag, exponent);
+                scaled = false;
             }
+        }
+        complexDouble reference = referenceOrbit[iteration];
+        z.real = reference.real + (scaled ? ldexp(d.real, exponent) : d.real);
+        z.imag = reference.imag + (scaled ? ldexp(d.imag, exponent) : d.imag);
+        if (detectGlitches && isGlitched(z, reference)) {
+            *glitched = true;
+            break;
+        }
+    }
+    return shadePixel(iteration, maxIterations, z, der);
+}
 
-            double rationalIteration = iteration + 2 - log(log(z.real * z.real + z.imag * z.imag)) / log((double)2);
-            if (iteration == maxIterations) {
-                pixelArr[pixelIndex] = ((uint)(255) << 24); // black
+// renders the whole frame by perturbation, for views too deep for double pixel coordinates; work groups claim tiles
+// in the same order as juliaKernel with tileClaiming == 1. zoom and offset come as the host's floatExp and are brought to
+// units of 2^scaleExponent here: scaleExponent is 0, or the zoom's exponent for views deeper than doubles reach.
+// With pixelList, only its pixelCount pixels (y * screenWidth + x) are rendered, TILE_PIXELS of them per claim; that is how
+// the host re-renders glitched pixels around another reference. Unless glitchList is NULL, glitched pixels are appended to
+// it, glitchCount counts them and must start at 0. With tileList instead, just the tiles detectCollapseKernel listed in it
+// are rendered, the ones a double render of the frame doesn't resolve.
+__kernel void perturbationKernel(__global gBufferPixel* gBuffer, int screenWidth, int screenHeight, floatExp frameZoom, int maxIterations,
+    __global int* globalIndex, __global int* cancelGeneration, double cX, double cY, __global const complexDouble* referenceOrbit, int referenceLength, floatExp frameOffsetX, floatExp frameOffsetY,
+    __global const blaStep* blaTable, int blaLevels, __global uint* skippedIterations, int scaleExponent,
+    __global const int* pixelList, int pixelCount, __global int* glitchList, __global int* glitchCount, __global const int* tileList) {
+    __local int claimedTile;
+    ulong skipped = 0;
+    double zoom = floatExpScaled(frameZoom, scaleExponent);
+    double offsetX = floatExpScaled(frameOffsetX, scaleExponent);
+    double offsetY = floatExpScaled(frameOffsetY, scaleExponent);
+    int tilesX = (screenWidth + TILE_SIZE - 1) / TILE_SIZE;
+    int tilesY = (screenHeight + TILE_SIZE - 1) / TILE_SIZE;
+    int blocksX = (tilesX + SUPER_TILE - 1) / SUPER_TILE;
+    int blocksY = (tilesY + SUPER_TILE - 1) / SUPER_TILE;
+    int totalTiles = pixelList != NULL ? (pixelCount + TILE_PIXELS - 1) / TILE_PIXELS : blocksX * blocksY * SUPER_TILE * SUPER_TILE;
+    if (tileList != NULL) { totalTiles = tileList[0]; }
+
+    while (1) {
+        if (get_local_id(0) == 0) {
+            claimedTile = frameAbandoned(globalIndex, cancelGeneration) ? INT_MAX : atomic_inc(globalIndex);
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+        int tile = claimedTile;
+        barrier(CLK_LOCAL_MEM_FENCE);
+        if (tile >= totalTiles) { break; }
+        if (tileList != NULL) { tile = tileList[1 + tile]; }
+
+        int2 tileXY = tileCoordinate(tile, blocksX);
+        for (int p = get_local_id(0); p < TILE_PIXELS; p += get_local_size(0)) {
+            int x, y;
+            if (pixelList != NULL) {
+                if (tile * TILE_PIXELS + p >= pixelCount) { continue; }
+                x = pixelList[tile * TILE_PIXELS + p] % screenWidth;
+                y = pixelList[tile * TILE_PIXELS + p] / screenWidth;
+            }
+            else {
+                x = tileXY.x * TILE_SIZE + p % TILE_SIZE;
+                y = tileXY.y * TILE_SIZE + p / TILE_SIZE;
+                if (x >= screenWidth || y >= screenHeight) { continue; }
+            }
+            bool glitched = false;
+            if (scaleExponent != 0) {
+                gBuffer[y * screenWidth + x] = juliaExtendedPixel(x, y, screenWidth, screenHeight, zoom, maxIterations, cX, cY, referenceOrbit, referenceLength, offsetX, offsetY,
+                    blaTable, blaLevels, scaleExponent, &skipped, glitchList != NULL, &glitched);
             }
             else {
-                pixelArr[pixelIndex] = ((uint)(255) << 24)
-                    | ((uint)(palette(rationalIteration, 1, 0)) << 16) // red
-                    | ((uint)(palette(rationalIteration, 1, 1)) << 8) // green
-                    | ((uint)(palette(rationalIteration, 1, 2)) << 0); // blue
+                gBuffer[y * screenWidth + x] = juliaPerturbationPixel(x, y, screenWidth, screenHeight, zoom, maxIterations, cX, cY, referenceOrbit, referenceLength, offsetX, offsetY, blaTable, blaLevels, &skipped, glitchList != NULL, &glitched);
             }
-            idx = atomic_inc(globalIndex);
+            if (glitched) { glitchList[atomic_inc(glitchCount)] = y * screenWidth + x; }
         }
     }
-    if (colouringScheme == 1) {
-        int i = get_global_id(0);
-        int totalPixels = screenWidth * screenHeight;
-        int idx = atomic_inc(globalIndex);
-        double temp;
 
-        double pi = 3.14159265358979323846;
-        double h2 = 1.5;
-        double angle = 45;
-        double radians = angle * (pi / 180);
-        complexDouble v = { cos(radians), sin(radians) };
-        double R = 100;
+    if (skipped > 0) { addSkippedIterations(skippedIterations, skipped); }
+}
 
-        while (idx < totalPixels) {
-            int pixelIndex = workQueue[idx];
-            int x = pixelIndex % screenWidth;
-            int y = pixelIndex / screenHeight;
-            double aspectRatio = (double)screenWidth / screenHeight;
-            int iteration = 0;
-            complexDouble z = { ((double)x / screenWidth - 0.5) * zoom * aspectRatio + positionX, ((double)y / screenWidth - 0.5) * zoom + positionY };
-            complexDouble zOld = { 0,0 };
-            const complexDouble complexPoint = { cX, cY };
-            int boundedThreshold = 8 * 8;
-            int period = 0;
-
-            complexDouble dc = { 1,0 };
-            complexDouble der = { 1,0 };
-
-            // stops when abs(z) >= sqrt(boundedThreshold), at which point we estimate that z is unbounded at complexPoint, so that complexPoint is not in the mandelbrot set
-            while (z.real * z.real + z.imag * z.imag < boundedThreshold && ++iteration < maxIterations) {
-                // der = der*2*z + dc
-                temp = (der.real * z.imag + der.imag * z.real) * 2 + dc.imag;
-                der.real = (der.real * z.real - der.imag * z.imag) * 2 + dc.real;
-                der.imag = temp;
-
-                // z = z^2 + c
-                temp = 2 * z.real * z.imag + complexPoint.imag;
-                z.real = z.real * z.real - z.imag * z.imag + complexPoint.real;
-                z.imag = temp;
+// Checks the tiles this build of juliaKernel just rendered, one work item per tile in the same numbering, and appends the
+// ones it doesn't resolve to escalatedTiles ([0] the count, which must start at 0, then the tiles) for the next tier to
+// render again from the list, without the host looking at it. A tile is flagged when two adjacent pixels' coordinates
+// round to the same tierReal, when a row of it has FLAT_RUN escaped pixels with identical G-buffer entries, which distinct
+// points practically never give, or when the pixel spacing is below limit times its largest coordinate (0: no such test).
+// Pixels in copyRect are left to the mirror pass and skipped.
+__kernel void detectCollapseKernel(__global const gBufferPixel* gBuffer, int screenWidth, int screenHeight, double zoom,
+    double positionX, double positionY, int4 copyRect, int4 floatRect, double limit, __global int* escalatedTiles) {
+    int tilesX = (screenWidth + TILE_SIZE - 1) / TILE_SIZE;
+    int tilesY = (screenHeight + TILE_SIZE - 1) / TILE_SIZE;
+    int blocksX = (tilesX + SUPER_TILE - 1) / SUPER_TILE;
+    int blocksY = (tilesY + SUPER_TILE - 1) / SUPER_TILE;
+    int tile = get_global_id(0);
+    if (tile >= blocksX * blocksY * SUPER_TILE * SUPER_TILE) { return; }
+    int2 tileXY = tileCoordinate(tile, blocksX);
+    int tileX = tileXY.x * TILE_SIZE;
+    int tileY = tileXY.y * TILE_SIZE;
+    if (tileX >= screenWidth || tileY >= screenHeight) { return; } // a tile of the padding around the frame
+    int lastX = min(tileX + TILE_SIZE, screenWidth) - 1;
+    int lastY = min(tileY + TILE_SIZE, screenHeight) - 1;
+    if ((insideRect(floatRect, tileX, tileY) && insideRect(floatRect, lastX, lastY)) != FLOAT_BUILD) { return; } // the other build's tile
 
-                if (z.real == zOld.real && z.imag == zOld.imag) {
-                    iteration = maxIterations;
-                    break;
+    // the coordinates as juliaPixel rounds them
+    double aspectRatio = (double)screenWidth / screenHeight;
+    bool collapsed = false;
+    tierReal previous = (tierReal)(((double)tileX / screenWidth - 0.5) * zoom * aspectRatio + positionX);
+    for (int x = tileX + 1; x <= lastX && !collapsed; x++) {
+        tierReal next = (tierReal)(((double)x / screenWidth - 0.5) * zoom * aspectRatio + positionX);
+        collapsed = next == previous;
+        previous = next;
+    }
+    previous = (tierReal)(((double)tileY / screenHeight - 0.5) * zoom + positionY);
+    for (int y = tileY + 1; y <= lastY && !collapsed; y++) {
+        tierReal next = (tierReal)(((double)y / screenHeight - 0.5) * zoom + positionY);
+        collapsed = next == previous;
+        previous = next;
+    }
+    double largest = fmax(fmax(fabs(((double)tileX / screenWidth - 0.5) * zoom * aspectRatio + positionX), fabs(((double)lastX / screenWidth - 0.5) * zoom * aspectRatio + positionX)),
+        fmax(fabs(((double)tileY / screenHeight - 0.5) * zoom + positionY), fabs(((double)lastY / screenHeight - 0.5) * zoom + positionY)));
+    if (zoom / screenHeight < limit * largest) { collapsed = true; }
+
+    for (int y = tileY; y <= lastY && !collapsed; y++) {
+        int run = 1;
+        for (int x = tileX + 1; x <= lastX && !collapsed; x++) {
+            gBufferPixel left = gBuffer[y * screenWidth + x - 1];
+            gBufferPixel pixel = gBuffer[y * screenWidth + x];
+            bool same = !pixel.interior && !left.interior && !insideRect(copyRect, x - 1, y) && !insideRect(copyRect, x, y)
+                && pixel.smoothIteration == left.smoothIteration && pixel.magnitude == left.magnitude && pixel.normalAngle == left.normalAngle;
+            run = same ? run + 1 : 1;
+            collapsed = run >= FLAT_RUN;
+        }
+    }
+    if (collapsed) { escalatedTiles[1 + atomic_inc(&escalatedTiles[0])] = tile; }
+}
+
+// the parts of rect outside copyRect: the rows above and below it and the columns beside it, at most four rectangles
+inline int clipRect(int4 rect, int4 copyRect, int4* pieces) {
+    int left = max(rect.x, copyRect.x);
+    int right = min(rect.x + rect.z, copyRect.x + copyRect.z);
+    int top = max(rect.y, copyRect.y);
+    int bottom = min(rect.y + rect.w, copyRect.y + copyRect.w);
+    if (left >= right || top >= bottom) {
+        pieces[0] = rect;
+        return 1;
+    }
+    int count = 0;
+    if (top > rect.y) { pieces[count++] = (int4)(rect.x, rect.y, rect.z, top - rect.y); }
+    if (bottom < rect.y + rect.w) { pieces[count++] = (int4)(rect.x, bottom, rect.z, rect.y + rect.w - bottom); }
+    if (left > rect.x) { pieces[count++] = (int4)(rect.x, top, left - rect.x, bottom - top); }
+    if (right < rect.x + rect.z) { pieces[count++] = (int4)(right, top, rect.x + rect.z - right, bottom - top); }
+    return count;
+}
+
+// i-th of the 2 * width + 2 * (height - 2) border pixels of rect: the top row, the bottom row, then the left and right columns between them
+inline int2 borderPixel(int4 rect, int i) {
+    if (i < rect.z) { return (int2)(rect.x + i, rect.y); }
+    i -= rect.z;
+    if (i < rect.z) { return (int2)(rect.x + i, rect.y + rect.w - 1); }
+    i -= rect.z;
+    if (i < rect.w - 2) { return (int2)(rect.x, rect.y + 1 + i); }
+    return (int2)(rect.x + rect.z - 1, rect.y + 1 + i - (rect.w - 2));
+}
+
+// i-th of the guard x guard probes spread evenly over the inside of rect
+inline int2 guardPixel(int4 rect, int guard, int i) {
+    return (int2)(rect.x + (2 * (i % guard) + 1) * rect.z / (2 * guard), rect.y + (2 * (i / guard) + 1) * rect.w / (2 * guard));
+}
+
+// pixel (x, y) of a rectangle whose border all stopped at the same iteration, blended from the rectangle's corners
+// so that filled exterior bands keep their smooth colouring; an interior rectangle stays interior
+inline gBufferPixel interpolatePixel(__global const gBufferPixel* gBuffer, int screenWidth, int4 rect, int x, int y) {
+    gBufferPixel topLeft = gBuffer[rect.y * screenWidth + rect.x];
+    if (topLeft.interior) { return topLeft; }
+    gBufferPixel topRight = gBuffer[rect.y * screenWidth + rect.x + rect.z - 1];
+    gBufferPixel bottomLeft = gBuffer[(rect.y + rect.w - 1) * screenWidth + rect.x];
+    gBufferPixel bottomRight = gBuffer[(rect.y + rect.w - 1) * screenWidth + rect.x + rect.z - 1];
+    float fx = (float)(x - rect.x) / (rect.z - 1);
+    float fy = (float)(y - rect.y) / (rect.w - 1);
+    float w00 = (1 - fx) * (1 - fy);
+    float w10 = fx * (1 - fy);
+    float w01 = (1 - fx) * fy;
+    float w11 = fx * fy;
+
+    gBufferPixel result;
+    result.smoothIteration = w00 * topLeft.smoothIteration + w10 * topRight.smoothIteration + w01 * bottomLeft.smoothIteration + w11 * bottomRight.smoothIteration;
+    result.magnitude = w00 * topLeft.magnitude + w10 * topRight.magnitude + w01 * bottomLeft.magnitude + w11 * bottomRight.magnitude;
+    // blend the normals as unit vectors so angles either side of +-pi don't average to 0
+    float normalX = w00 * cos(topLeft.normalAngle) + w10 * cos(topRight.normalAngle) + w01 * cos(bottomLeft.normalAngle) + w11 * cos(bottomRight.normalAngle);
+    float normalY = w00 * sin(topLeft.normalAngle) + w10 * sin(topRight.normalAngle) + w01 * sin(bottomLeft.normalAngle) + w11 * sin(bottomRight.normalAngle);
+    result.normalAngle = atan2(normalY, normalX);
+    result.interior = 0;
+    return result;
+}
+
+// iterates pixel (x, y) for the Mariani-Silver passes unless an earlier pass already did, and records its iteration count
+inline void marianiSilverPixel(__global gBufferPixel* gBuffer, __global int* iterationCounts, int x, int y, int screenWidth, int screenHeight,
+    double zoom, double positionX, double positionY, int maxIterations, double cX, double cY, double cycleTolerance, int* cyclePixels, int* iteratedPixels) {
+    int pixelIndex = y * screenWidth + x;
+    if (iterationCounts[pixelIndex] >= 0) { return; }
+    int finalIteration;
+    gBuffer[pixelIndex] = juliaPixel(x, y, screenWidth, screenHeight, zoom, positionX, positionY, maxIterations, cX, cY, 0, STATE_NONE, 0, cycleTolerance, cyclePixels, &finalIteration);
+    iterationCounts[pixelIndex] = finalIteration;
+    (*iteratedPixels)++;
+}
+
+// One pass of the Mariani-Silver mode, run in place of juliaKernel. Each work group claims a rectangle and iterates its
+// border; if every border pixel, and every one of the guard x guard probes inside, stopped at the same iteration, the rest
+// of the rectangle is filled in without iterating, otherwise it is split into four for the next pass. Pass 0 walks a grid
+// of MS_BLOCK_SIZE squares with copyRect cut out, later passes take the rectangles the previous pass wrote. Rectangles too
+// small to split, and all of them on the last pass, are iterated in full.
+// rectCounts[pass & 1] is the number of rectsIn, rectCounts[(pass + 1) & 1] counts the rectsOut written and must start at 0.
+// iterationCounts must start at -1; every pixel that is actually iterated is counted into iteratedPixels.
+__kernel void marianiSilverKernel(__global gBufferPixel* gBuffer, int screenWidth, int screenHeight, double zoom,
+    double positionX, double positionY, int maxIterations, __global int* globalIndex, __global int* cancelGeneration, double cX, double cY, int4 copyRect, double cycleTolerance,
+    __global int* interiorCounts, __global int* iterationCounts, __global const int4* rectsIn, __global int4* rectsOut,
+    __global int* rectCounts, __global int* iteratedPixels, int pass, int lastPass, int guard) {
+    __local int claimedRect;
+    __local int sameCount;
+    int cyclePixels = 0;
+    int iterated = 0;
+    int blocksX = (screenWidth + MS_BLOCK_SIZE - 1) / MS_BLOCK_SIZE;
+    int blocksY = (screenHeight + MS_BLOCK_SIZE - 1) / MS_BLOCK_SIZE;
+    int totalRects = pass == 0 ? blocksX * blocksY : rectCounts[pass & 1];
+
+    while (1) {
+        if (get_local_id(0) == 0) {
+            claimedRect = frameAbandoned(globalIndex, cancelGeneration) ? INT_MAX : atomic_inc(globalIndex);
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+        int index = claimedRect;
+        barrier(CLK_LOCAL_MEM_FENCE);
+        if (index >= totalRects) { break; }
+
+        int4 rects[4];
+        int rectCount = 1;
+        if (pass == 0) {
+            int4 block = (int4)((index % blocksX) * MS_BLOCK_SIZE, (index / blocksX) * MS_BLOCK_SIZE, 0, 0);
+            block.z = min(MS_BLOCK_SIZE, screenWidth - block.x);
+            block.w = min(MS_BLOCK_SIZE, screenHeight - block.y);
+            rectCount = clipRect(block, copyRect, rects);
+        }
+        else {
+            rects[0] = rectsIn[index];
+        }
+
+        for (int r = 0; r < rectCount; r++) {
+            int4 rect = rects[r];
+            if (lastPass || rect.z <= MS_SPLIT_SIZE || rect.w <= MS_SPLIT_SIZE) {
+                for (int p = get_local_id(0); p < rect.z * rect.w; p += get_local_size(0)) {
+                    marianiSilverPixel(gBuffer, iterationCounts, rect.x + p % rect.z, rect.y + p / rect.z, screenWidth, screenHeight,
+                        zoom, positionX, positionY, maxIterations, cX, cY, cycleTolerance, &cyclePixels, &iterated);
                 }
+                continue;
+            }
+
+            // everyone has read sameCount for the previous rectangle
+            barrier(CLK_LOCAL_MEM_FENCE);
+            if (get_local_id(0) == 0) { sameCount = 1; }
+            int borderPixels = 2 * rect.z + 2 * (rect.w - 2);
+            for (int i = get_local_id(0); i < borderPixels; i += get_local_size(0)) {
+                int2 pixel = borderPixel(rect, i);
+                marianiSilverPixel(gBuffer, iterationCounts, pixel.x, pixel.y, screenWidth, screenHeight,
+                    zoom, positionX, positionY, maxIterations, cX, cY, cycleTolerance, &cyclePixels, &iterated);
+            }
+            barrier(CLK_GLOBAL_MEM_FENCE | CLK_LOCAL_MEM_FENCE);
+            int count = iterationCounts[rect.y * screenWidth + rect.x];
+            for (int i = get_local_id(0); i < borderPixels; i += get_local_size(0)) {
+                int2 pixel = borderPixel(rect, i);
+                if (iterationCounts[pixel.y * screenWidth + pixel.x] != count) { sameCount = 0; }
+            }
+            barrier(CLK_LOCAL_MEM_FENCE);
+            int fill = sameCount;
 
-                if (period++ > 50) {
-                    period = 0;
-                    zOld.real = z.real;
-                    zOld.imag = z.imag;
+            // a filament thinner than a pixel can cross the rectangle between two border pixels, probe the inside too
+            if (fill && guard > 0) {
+                for (int i = get_local_id(0); i < guard * guard; i += get_local_size(0)) {
+                    int2 pixel = guardPixel(rect, guard, i);
+                    marianiSilverPixel(gBuffer, iterationCounts, pixel.x, pixel.y, screenWidth, screenHeight,
+                        zoom, positionX, positionY, maxIterations, cX, cY, cycleTolerance, &cyclePixels, &iterated);
                 }
+                barrier(CLK_GLOBAL_MEM_FENCE | CLK_LOCAL_MEM_FENCE);
+                for (int i = get_local_id(0); i < guard * guard; i += get_local_size(0)) {
+                    int2 pixel = guardPixel(rect, guard, i);
+                    if (iterationCounts[pixel.y * screenWidth + pixel.x] != count) { sameCount = 0; }
+                }
+                barrier(CLK_LOCAL_MEM_FENCE);
+                fill = sameCount;
             }
 
-            if (iteration == maxIterations) {
-                pixelArr[pixelIndex] = ((uint)(255) << 24); // black
+            if (fill) {
+                for (int p = get_local_id(0); p < rect.z * rect.w; p += get_local_size(0)) {
+                    int x = rect.x + p % rect.z;
+                    int y = rect.y + p / rect.z;
+                    if (iterationCounts[y * screenWidth + x] < 0) {
+                        gBuffer[y * screenWidth + x] = interpolatePixel(gBuffer, screenWidth, rect, x, y);
+                    }
+                }
             }
-            else {
-                // u = z/der
-                double denom = der.real * der.real + der.imag * der.imag;
-                complexDouble u = {
-                    (z.real * der.real + z.imag * der.imag) / denom,
-                    (z.imag * der.real - z.real * der.imag) / denom
-                };
+            else if (get_local_id(0) == 0) {
+                int halfWidth = rect.z / 2;
+                int halfHeight = rect.w / 2;
+                int slot = atomic_add(&rectCounts[(pass + 1) & 1], 4);
+                rectsOut[slot] = (int4)(rect.x, rect.y, halfWidth, halfHeight);
+                rectsOut[slot + 1] = (int4)(rect.x + halfWidth, rect.y, rect.z - halfWidth, halfHeight);
+                rectsOut[slot + 2] = (int4)(rect.x, rect.y + halfHeight, halfWidth, rect.w - halfHeight);
+                rectsOut[slot + 3] = (int4)(rect.x + halfWidth, rect.y + halfHeight, rect.z - halfWidth, rect.w - halfHeight);
+            }
+        }
+    }
 
-                // temp = abs(u)
-                temp = sqrt(u.real * u.real + u.imag * u.imag);
+    if (cyclePixels > 0) { atomic_add(&interiorCounts[1], cyclePixels); }
+    if (iterated > 0) { atomic_add(iteratedPixels, iterated); }
+}
 
-                // u = u/abs(u)
-                u.real = u.real / temp;
-                u.imag = u.imag / temp;
+// copies the last frame's G-buffer into gBuffer moved by (shiftX, shiftY) pixels, for a view that was panned by whole pixels;
+// the pixels scrolling in from outside are left to the compute kernel
+__kernel void shiftKernel(__global const gBufferPixel* previous, __global gBufferPixel* gBuffer, int screenWidth, int screenHeight, int shiftX, int shiftY) {
+    int totalPixels = screenWidth * screenHeight;
+    for (int idx = get_global_id(0); idx < totalPixels; idx += get_global_size(0)) {
+        int x = idx % screenWidth + shiftX;
+        int y = idx / screenWidth + shiftY;
+        if (x >= 0 && x < screenWidth && y >= 0 && y < screenHeight) {
+            gBuffer[idx] = previous[y * screenWidth + x];
+        }
+    }
+}
 
-                double t = u.real * v.real - u.imag * v.imag + h2;
+// fills gBuffer with the nearest pixels of previous, a frame of the same size rendered at scale times the zoom and offset by
+// (offsetX, offsetY) of its own pixels, to preview a zoom without iterating. With markReused, iterationCounts gets 0 for the
+// pixels that land exactly on one of previous's and -1 for the rest, so that the compute kernel skips the former.
+__kernel void reprojectKernel(__global const gBufferPixel* previous, __global gBufferPixel* gBuffer, __global int* iterationCounts,
+    int screenWidth, int screenHeight, double scale, double offsetX, double offsetY, int markReused) {
+    int totalPixels = screenWidth * screenHeight;
+    for (int idx = get_global_id(0); idx < totalPixels; idx += get_global_size(0)) {
+        int x = idx % screenWidth;
+        int y = idx / screenWidth;
+        double sourceX = (x - 0.5 * screenWidth) * scale + 0.5 * screenWidth + offsetX;
+        double sourceY = (y - 0.5 * screenHeight) * scale + 0.5 * screenHeight + offsetY;
+        int nearestX = clamp((int)floor(sourceX + 0.5), 0, screenWidth - 1);
+        int nearestY = clamp((int)floor(sourceY + 0.5), 0, screenHeight - 1);
+        gBuffer[idx] = previous[nearestY * screenWidth + nearestX];
+        if (markReused) { iterationCounts[idx] = sourceX == nearestX && sourceY == nearestY ? 0 : -1; }
+    }
+}
 
-                t /= 1 + h2;
+// fills copyRect of the G-buffer from the pixels mirrored through the origin, which juliaKernel rendered
+__kernel void mirrorKernel(__global gBufferPixel* gBuffer, int screenWidth, int4 copyRect, int mirrorX, int mirrorY) {
+    float pi = 3.14159265f;
+    int totalPixels = copyRect.z * copyRect.w;
+    for (int i = get_global_id(0); i < totalPixels; i += get_global_size(0)) {
+        int x = copyRect.x + i % copyRect.z;
+        int y = copyRect.y + i / copyRect.z;
+        gBufferPixel pixel = gBuffer[(mirrorY - y) * screenWidth + mirrorX - x];
+        pixel.normalAngle = pixel.normalAngle > 0 ? pixel.normalAngle - pi : pixel.normalAngle + pi; // -z, same derivative
+        gBuffer[y * screenWidth + x] = pixel;
+    }
+}
 
-                if (t < 0) { t = 0; }
+// turns the G-buffer written by juliaKernel into pixels, cheap enough to rerun every frame the palette or lighting changes
+__kernel void colourKernel(__global const gBufferPixel* gBuffer, __global uint* pixelArr, int totalPixels,
+    int colouringScheme, double colourCycle, double lightAngle, double lightHeight, __constant uint* palette) {
+    double pi = 3.14159265358979323846;
+    double radians = lightAngle * (pi / 180);
 
-                pixelArr[pixelIndex] = ((uint)(255) << 24)
-                    | ((uint)(255 * t) << 16) // red
-                    | ((uint)(255 * t) << 8) // green
-                    | ((uint)(255 * t) << 0); // blue
-            }
-            idx = atomic_inc(globalIndex);
+    for (int idx = get_global_id(0); idx < totalPixels; idx += get_global_size(0)) {
+        gBufferPixel pixel = gBuffer[idx];
+        if (pixel.interior) {
+            pixelArr[idx] = ((uint)(255) << 24); // black
+            continue;
         }
+        if (colouringScheme == 0) {
+            // one palette period per unit of log(smooth iteration), looked up in the table baked by the host
+            float position = native_log(pixel.smoothIteration) + (float)colourCycle;
+            position -= floor(position);
+            pixelArr[idx] = palette[clamp((int)(position * PALETTE_SIZE), 0, PALETTE_SIZE - 1)];
+            continue;
+        }
+
+        // u.v with u the unit normal and v the light direction
+        double t = cos((double)pixel.normalAngle + radians) + lightHeight;
+        t /= 1 + lightHeight;
+        if (t < 0) { t = 0; }
+
+        pixelArr[idx] = ((uint)(255) << 24)
+            | ((uint)(t * 255) << 16) // red
+            | ((uint)(t * 255) << 8) // green
+            | ((uint)(t * 255) << 0); // blue
     }
-}
\ No newline at end of file
+}
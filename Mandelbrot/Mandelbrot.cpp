@@ -1,8 +1,14 @@
 #include <iostream>
 #include <SDL/SDL.h>
 #include <chrono>
+#ifdef _WIN32
 #include <Windows.h>
 #include <ppl.h>
+#else
+#define WINAPI
+typedef void* HINSTANCE;
+typedef char* LPSTR;
+#endif
 #include <vector>
 #include <sstream>
 #include <cmath>
@@ -11,19 +17,33 @@
 #include <omp.h>
 #include <fstream>
 #include <SDL/SDL_ttf.h>
+#include <thread>
 #include "fractals.h"
+#include "mailbox.h"
 #include <unordered_map>
 #include "globals.h"
 #include "input.h"
 #include "handle errors.h"
+#include "benchmark.h"
 
 #define MAX_SOURCE_SIZE (0x100000)
 
 using namespace std;
+#ifdef _WIN32
 using namespace concurrency;
+#endif
 
 const bool debugFrameTime = 1;
+const bool debugWorkerStats = 0; //log per-worker CPU renderer stats once a second
+const bool debugInteriorStats = 0; //log how many pixels the interior tests finished early, once a second
+const bool debugMarianiSilverStats = 0; //log how many pixels the Mariani-Silver mode actually iterated, once a second
+const bool debugSkippedIterations = 0; //log how many iterations BLA steps skipped in perturbation frames, once a second
+const bool debugGlitchStats = 0; //log how many reference orbits perturbation frames used and how many glitched pixels they re-rendered, once a second
+const bool benchmarkClaimModes = 0; //time per-pixel against tile work claiming at startup
+const bool benchmarkSquaring = 0; //time fixed-point squaring against multiplication at startup
 const bool fullscreen = 1;
+const bool forceCpuBackend = 0; //render on the CPU even if an OpenCL GPU is available
+bool useCpuBackend = forceCpuBackend;
 bool FPSCounter = 1;
 bool shouldRenderJuliaSet = 1;
 int frameRateCap = 0; //set to 0 for native refresh rate, -1 for uncapped
@@ -33,6 +53,8 @@ int screenHeight = 0;
 
 SDL_Window* window = NULL;
 SDL_Renderer* renderer = NULL;
+cpuRenderer cpuEngine;
+colourPalette palette;
 
 std::chrono::time_point<std::chrono::high_resolution_clock> frameStart;
 std::chrono::time_point<std::chrono::high_resolution_clock> frameEnd;
@@ -87,11 +109,102 @@ struct text {
     }
 };
 
-void swapClMemObjects(cl_mem& mem1, cl_mem& mem2) {
-    cl_mem temp = mem1;
-    mem1 = mem2;
-    mem2 = temp;
-}
+// The UI thread's side of a fractal: the view handleInput steers and the texture showing the newest frame the render
+// thread published for it.
+struct fractalScreen {
+    fractalView view;
+    SDL_Rect rect;
+    SDL_Texture* texture = NULL; //streaming, in pixelFormat, made again whenever a frame of another size arrives
+    int tier = tierDouble; //the shown frame's, for the HUD
+
+    ~fractalScreen() {
+        if (texture) {
+            SDL_DestroyTexture(texture);
+        }
+    }
+
+    // Writes frame into texture, straight into the locked pixels, row by row if the texture's rows are padded. On the GPU
+    // path frame.pixels is the mapped frame slot itself, so this is the only copy a frame goes through on the host.
+    void show(const finishedFrame& frame) {
+        int textureWidth = 0, textureHeight = 0;
+        if (texture) { SDL_QueryTexture(texture, NULL, NULL, &textureWidth, &textureHeight); }
+        if (textureWidth != frame.width || textureHeight != frame.height) {
+            if (texture) {
+                SDL_DestroyTexture(texture);
+            }
+            texture = SDL_CreateTexture(renderer, pixelFormat, SDL_TEXTUREACCESS_STREAMING, frame.width, frame.height);
+            if (texture == NULL) {
+                printf("Texture could not be created! SDL_Error: %s\n", SDL_GetError());
+                return;
+            }
+        }
+        void* pixels = NULL;
+        int pitch = 0;
+        if (SDL_LockTexture(texture, NULL, &pixels, &pitch) != 0) {
+            std::cerr << "Warning: Failed to lock texture: " << SDL_GetError() << std::endl;
+            return;
+        }
+        size_t rowBytes = frame.width * sizeof(uint32_t);
+        if (pitch == (int)rowBytes) { memcpy(pixels, frame.pixels, rowBytes * frame.height); }
+        else {
+            for (int y = 0; y < frame.height; y++) { memcpy((char*)pixels + (size_t)y * pitch, frame.pixels + (size_t)y * frame.width, rowBytes); }
+        }
+        SDL_UnlockTexture(texture);
+        tier = frame.tier;
+    }
+};
+
+// Everything the render thread renders from, published by the UI thread once per loop.
+struct viewSnapshot {
+    fractalView mandelbrot;
+    fractalView julia;
+    bool juliaActive = false;
+    colourPalette palette;
+};
+
+// One fractal's kernels: compute is mandelbrotKernel or juliaKernel, the float ones come from the FLOAT_TIER build of
+// the same source. All stay NULL on the CPU renderer.
+struct fractalKernels {
+    cl_kernel compute = NULL;
+    cl_kernel colour = NULL;
+    cl_kernel mirror = NULL;
+    cl_kernel marianiSilver = NULL;
+    cl_kernel shift = NULL;
+    cl_kernel reproject = NULL;
+    cl_kernel perturbation = NULL;
+    cl_kernel detect = NULL;
+    cl_kernel floatCompute = NULL;
+    cl_kernel floatMarianiSilver = NULL;
+    cl_kernel floatDetect = NULL;
+
+    void create(cl_program program, cl_program floatProgram, const char* computeName) {
+        compute = clCreateKernel(program, computeName, &err);
+        colour = clCreateKernel(program, "colourKernel", &err);
+        mirror = clCreateKernel(program, "mirrorKernel", &err);
+        marianiSilver = clCreateKernel(program, "marianiSilverKernel", &err);
+        shift = clCreateKernel(program, "shiftKernel", &err);
+        reproject = clCreateKernel(program, "reprojectKernel", &err);
+        perturbation = clCreateKernel(program, "perturbationKernel", &err);
+        detect = clCreateKernel(program, "detectCollapseKernel", &err);
+        floatCompute = clCreateKernel(floatProgram, computeName, &err);
+        floatMarianiSilver = clCreateKernel(floatProgram, "marianiSilverKernel", &err);
+        floatDetect = clCreateKernel(floatProgram, "detectCollapseKernel", &err);
+    }
+
+    void release() {
+        clReleaseKernel(compute);
+        clReleaseKernel(colour);
+        clReleaseKernel(mirror);
+        clReleaseKernel(marianiSilver);
+        clReleaseKernel(shift);
+        clReleaseKernel(reproject);
+        clReleaseKernel(perturbation);
+        clReleaseKernel(detect);
+        clReleaseKernel(floatCompute);
+        clReleaseKernel(floatMarianiSilver);
+        clReleaseKernel(floatDetect);
+    }
+};
 
 std::string loadKernelSource(const std::string& filename) {
     std::ifstream file(filename);
@@ -104,14 +217,46 @@ std::string loadKernelSource(const std::string& filename) {
     return buffer.str();
 }
 
-void swapFractalSizes(juliaSet &julia, mandelbrotSet &mandelbrot, cl_context context, cl_device_id device) {
-    array<int, 2> temp = { mandelbrot.width, mandelbrot.height };
-    mandelbrot.resize(julia.width, julia.height, renderer, window, context, device);
-    mandelbrot.rect = { mandelbrotGap, mandelbrotGap, mandelbrot.surface->w, mandelbrot.surface->h };
-    julia.resize(temp[0], temp[1], renderer, window, context, device);
-    julia.rect = { screenWidth - julia.width - mandelbrotGap, mandelbrotGap, julia.surface->w, julia.surface->h };
-    julia.framesToUpdate = 4;
-    mandelbrot.framesToUpdate = 4;
+// Builds source for device with options, exiting with the build log if it does not compile. The log of a build that
+// succeeded is printed too, compiler warnings end up in it.
+cl_program buildProgram(cl_context context, cl_device_id device, const char* source, const char* options, const char* name) {
+    cl_int err;
+    cl_program program = clCreateProgramWithSource(context, 1, &source, NULL, &err);
+    if (err != CL_SUCCESS) {
+        DBOUT("Error: Failed to create " << name << " OpenCL program! " << getErrorString(err) << std::endl)
+        exit(1);
+    }
+
+    cl_int buildErr = clBuildProgram(program, 1, &device, options, NULL, NULL);
+    // Get the build log, at its full size
+    size_t logSize = 0;
+    err = clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, 0, NULL, &logSize);
+    if (err != CL_SUCCESS) {
+        std::cerr << "\n\nError: Failed to retrieve build log!\n\n" << std::endl;
+        exit(1);
+    }
+    std::string buildLog(logSize, '\0');
+    clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, logSize, &buildLog[0], NULL);
+    if (buildErr != CL_SUCCESS) {
+        DBOUT("Error in " << name << " kernel:\n" << buildLog.c_str() << std::endl)
+        exit(1);
+    }
+    // a clean build's log is usually empty or a lone newline; the 5 takes in the terminator logSize counts
+    if (buildLog.find_first_not_of(" \t\r\n", 0, 5) != std::string::npos) {
+        DBOUT("\n\n" << name << " build log:\n" << buildLog.c_str() << "\n\n")
+    }
+    return program;
+}
+
+// The render thread resizes the fractals when it takes the swapped views, and show makes the textures again when the
+// first frames of the new sizes arrive.
+void swapFractalSizes(fractalScreen &julia, fractalScreen &mandelbrot) {
+    std::swap(mandelbrot.view.width, julia.view.width);
+    std::swap(mandelbrot.view.height, julia.view.height);
+    mandelbrot.rect = { mandelbrotGap, mandelbrotGap, mandelbrot.view.width, mandelbrot.view.height };
+    julia.rect = { screenWidth - julia.view.width - mandelbrotGap, mandelbrotGap, julia.view.width, julia.view.height };
+    julia.view.framesToUpdate = 4;
+    mandelbrot.view.framesToUpdate = 4;
 }
 
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nShowCmd)
@@ -179,140 +324,124 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 
 
     // OpenCL initialization with platform and device selection
+    // falls back to the CPU renderer when there is no OpenCL platform or GPU to run the kernels on
     cl_int err;
     cl_uint num_platforms = 0;
-    err = clGetPlatformIDs(0, NULL, &num_platforms);
-    if (err != CL_SUCCESS || num_platforms == 0) {
-        std::cerr << "Error: Failed to find any OpenCL platforms!" << std::endl;
-        exit(1);
-    }
-
-    cl_platform_id* platforms = new cl_platform_id[num_platforms];
-    err = clGetPlatformIDs(num_platforms, platforms, NULL);
-    if (err != CL_SUCCESS) {
-        std::cerr << "Error: Failed to get OpenCL platform IDs!" << std::endl;
-        exit(1);
+    cl_platform_id* platforms = NULL;
+    cl_device_id* devices = NULL;
+    cl_device_id device = NULL;
+    cl_context context = NULL;
+    if (!useCpuBackend) {
+        err = clGetPlatformIDs(0, NULL, &num_platforms);
+        if (err != CL_SUCCESS || num_platforms == 0) {
+            std::cerr << "Warning: Failed to find any OpenCL platforms, using the CPU renderer" << std::endl;
+            useCpuBackend = true;
+        }
     }
 
-    // Select the first available platform (AMD, NVIDIA, etc.)
     cl_platform_id selectedPlatform = NULL;
-    char platformName[128];
-    for (cl_uint i = 0; i < num_platforms; ++i) {
-        err = clGetPlatformInfo(platforms[i], CL_PLATFORM_NAME, sizeof(platformName), platformName, NULL);
+    cl_uint num_devices = 0;
+    if (!useCpuBackend) {
+        platforms = new cl_platform_id[num_platforms];
+        err = clGetPlatformIDs(num_platforms, platforms, NULL);
         if (err != CL_SUCCESS) {
-            std::cerr << "Error: Failed to get platform name!" << std::endl;
+            std::cerr << "Error: Failed to get OpenCL platform IDs!" << std::endl;
             exit(1);
         }
-        selectedPlatform = platforms[i]; // Pick the first available platform
-        break;
-    }
-
-    if (selectedPlatform == NULL) {
-        std::cerr << "Error: No suitable OpenCL platform found!" << std::endl;
-        exit(1);
-    }
 
-    // Get devices from the selected platform
-    cl_uint num_devices = 0;
-    err = clGetDeviceIDs(selectedPlatform, CL_DEVICE_TYPE_GPU, 0, NULL, &num_devices);
-    if (err != CL_SUCCESS || num_devices == 0) {
-        std::cerr << "Error: Failed to find GPU devices on the selected platform!" << std::endl;
-        exit(1);
-    }
-
-    cl_device_id* devices = new cl_device_id[num_devices];
-    err = clGetDeviceIDs(selectedPlatform, CL_DEVICE_TYPE_GPU, num_devices, devices, NULL);
-    if (err != CL_SUCCESS) {
-        std::cerr << "Error: Failed to get device IDs from the selected platform!" << std::endl;
-        exit(1);
-    }
+        // Select the first available platform (AMD, NVIDIA, etc.)
+        char platformName[128];
+        for (cl_uint i = 0; i < num_platforms; ++i) {
+            err = clGetPlatformInfo(platforms[i], CL_PLATFORM_NAME, sizeof(platformName), platformName, NULL);
+            if (err != CL_SUCCESS) {
+                std::cerr << "Error: Failed to get platform name!" << std::endl;
+                exit(1);
+            }
+            selectedPlatform = platforms[i]; // Pick the first available platform
+            break;
+        }
 
-    cl_device_id device = devices[0];
+        if (selectedPlatform == NULL) {
+            std::cerr << "Error: No suitable OpenCL platform found!" << std::endl;
+            exit(1);
+        }
 
-    char deviceName[128];
-    err = clGetDeviceInfo(device, CL_DEVICE_NAME, sizeof(deviceName), deviceName, NULL);
-    if (err != CL_SUCCESS) {
-        std::cerr << "Error: Failed to get device name!" << std::endl;
-        exit(1);
+        // Get devices from the selected platform
+        err = clGetDeviceIDs(selectedPlatform, CL_DEVICE_TYPE_GPU, 0, NULL, &num_devices);
+        if (err != CL_SUCCESS || num_devices == 0) {
+            std::cerr << "Warning: Failed to find GPU devices on the selected platform, using the CPU renderer" << std::endl;
+            useCpuBackend = true;
+        }
     }
-    std::cout << "Using device: " << deviceName << std::endl;
-
-
-
-
-
-    cl_context context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
 
-    mandelbrotSet mandelbrot(screenWidth * 0.7, screenHeight - mandelbrotGap * 2, renderer, window, context, device);
-    mandelbrot.position[0] = -0.7;
-    juliaSet julia(screenWidth - mandelbrot.width - mandelbrotGap, screenWidth - mandelbrot.width - mandelbrotGap, renderer, window, context, device);
+    if (!useCpuBackend) {
+        devices = new cl_device_id[num_devices];
+        err = clGetDeviceIDs(selectedPlatform, CL_DEVICE_TYPE_GPU, num_devices, devices, NULL);
+        if (err != CL_SUCCESS) {
+            std::cerr << "Error: Failed to get device IDs from the selected platform!" << std::endl;
+            exit(1);
+        }
 
-    cl_program mandelbrotProgram = clCreateProgramWithSource(context, 1, &mandelbrotSourceStr, NULL, &err);
+        device = devices[0];
 
-    if (err != CL_SUCCESS) {
-        DBOUT("Error: Failed to create Mandelbrot OpenCL program! " << getErrorString(err) << std::endl)
-        exit(1);
-    }
+        char deviceName[128];
+        err = clGetDeviceInfo(device, CL_DEVICE_NAME, sizeof(deviceName), deviceName, NULL);
+        if (err != CL_SUCCESS) {
+            std::cerr << "Error: Failed to get device name!" << std::endl;
+            exit(1);
+        }
+        std::cout << "Using device: " << deviceName << std::endl;
 
-    err = clBuildProgram(mandelbrotProgram, 1, &device, NULL, NULL, NULL);
-    if (err != CL_SUCCESS) {
-        // Get the build log
-        size_t logSize;
-        clGetProgramBuildInfo(mandelbrotProgram, device, CL_PROGRAM_BUILD_LOG, 0, NULL, &logSize);
-        char* buildLog = new char[logSize + 1];
-        clGetProgramBuildInfo(mandelbrotProgram, device, CL_PROGRAM_BUILD_LOG, logSize, buildLog, NULL);
-        buildLog[logSize] = '\0';
-        DBOUT("Error in Mandelbrot kernel:\n" << buildLog << std::endl)
-        delete[] buildLog;
-        exit(1);
+        context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
     }
-
-    clBuildProgram(mandelbrotProgram, 1, &device, NULL, NULL, NULL);
-
-    cl_program juliaProgram = clCreateProgramWithSource(context, 1, &juliaSourceStr, NULL, &err);
-    if (err != CL_SUCCESS) {
-        DBOUT("Error: Failed to create Julia OpenCL program! " << getErrorString(err) << std::endl)
-        exit(1);
+    else {
+        std::cout << "Using device: CPU (" << instructionSetName(cpuEngine.instructionSet) << ")" << std::endl;
     }
 
-    err = clBuildProgram(juliaProgram, 1, &device, NULL, NULL, NULL);
-    if (err != CL_SUCCESS) {
-        // Get the build log
-        size_t logSize;
-        clGetProgramBuildInfo(juliaProgram, device, CL_PROGRAM_BUILD_LOG, 0, NULL, &logSize);
-        char* buildLog = new char[logSize + 1];
-        clGetProgramBuildInfo(juliaProgram, device, CL_PROGRAM_BUILD_LOG, logSize, buildLog, NULL);
-        buildLog[logSize] = '\0';
-        DBOUT("Error in Julia kernel:\n" << buildLog << std::endl)
-        delete[] buildLog;
-        exit(1);
+    mandelbrotSet mandelbrot(screenWidth * 0.7, screenHeight - mandelbrotGap * 2, context, device);
+    mandelbrot.position[0] = -0.7;
+    juliaSet julia(screenWidth - mandelbrot.width - mandelbrotGap, screenWidth - mandelbrot.width - mandelbrotGap, context, device);
+    mandelbrot.setActive(true, context, device); //the mouse starts over neither, the larger view is the active one
+
+    cl_program mandelbrotProgram = NULL;
+    cl_program juliaProgram = NULL;
+    cl_program mandelbrotFloatProgram = NULL; //same sources built with FLOAT_TIER, for the views float resolves
+    cl_program juliaFloatProgram = NULL;
+    fractalKernels mandelbrotKernels;
+    fractalKernels juliaKernels;
+    if (!useCpuBackend) {
+        // with SVM atomics the kernels load the cancelled generation atomically, see frameAbandoned in the kernels
+        bool svmCancel = hasSvmAtomics(device);
+        const char* options = svmCancel ? "-cl-std=CL2.0 -D SVM_CANCEL" : NULL;
+        const char* floatOptions = svmCancel ? "-cl-std=CL2.0 -D SVM_CANCEL -D FLOAT_TIER" : "-D FLOAT_TIER";
+        mandelbrotProgram = buildProgram(context, device, mandelbrotSourceStr, options, "Mandelbrot");
+        juliaProgram = buildProgram(context, device, juliaSourceStr, options, "Julia");
+        mandelbrotFloatProgram = buildProgram(context, device, mandelbrotSourceStr, floatOptions, "Mandelbrot float");
+        juliaFloatProgram = buildProgram(context, device, juliaSourceStr, floatOptions, "Julia float");
+
+        mandelbrotKernels.create(mandelbrotProgram, mandelbrotFloatProgram, "mandelbrotKernel");
+        juliaKernels.create(juliaProgram, juliaFloatProgram, "juliaKernel");
     }
 
-    clBuildProgram(juliaProgram, 1, &device, NULL, NULL, NULL);
-
-    char* buildLog = new char[16384];
-    size_t buildLogSize;
-    err = clGetProgramBuildInfo(mandelbrotProgram, device, CL_PROGRAM_BUILD_LOG, sizeof(buildLog), buildLog, &buildLogSize);
-    if (err != CL_SUCCESS) {
-        std::cerr << "\n\nError: Failed to retrieve build log!\n\n" << std::endl;
-        exit(1);
+    if (benchmarkClaimModes && !useCpuBackend) {
+        benchmarkWorkClaiming(mandelbrot, mandelbrotKernels.compute, "Mandelbrot");
+        benchmarkWorkClaiming(julia, juliaKernels.compute, "Julia");
     }
-    DBOUT("\n\nmandelbrot build log:\n" << buildLog << "\n\n")
-
-    err = clGetProgramBuildInfo(juliaProgram, device, CL_PROGRAM_BUILD_LOG, sizeof(buildLog), buildLog, &buildLogSize);
-    if (err != CL_SUCCESS) {
-        std::cerr << "\n\nError: Failed to retrieve build log!\n\n" << std::endl;
-        exit(1);
+    if (benchmarkSquaring) {
+        benchmarkFixedPoint();
     }
-    DBOUT("\n\njulia build log:\n" << buildLog << "\n\n")
 
-    cl_kernel mandelbrotKernel = clCreateKernel(mandelbrotProgram, "mandelbrotKernel", &err);
-    cl_kernel juliaKernel = clCreateKernel(juliaProgram, "juliaKernel", &err);
+    palette.load("Resources/palettes.txt");
 
     SDL_Texture* backgroundTexture = SDL_CreateTextureFromSurface(renderer, SDL_LoadBMP("Resources/background.bmp"));
 
-    mandelbrot.rect = { mandelbrotGap, mandelbrotGap, mandelbrot.surface->w, mandelbrot.surface->h };
-    julia.rect = { screenWidth - julia.width - mandelbrotGap, mandelbrotGap, julia.surface->w, julia.surface->h };
+    // the UI thread steers copies of the views and only ever touches the fractals through their frame mailboxes
+    fractalScreen mandelbrotScreen;
+    fractalScreen juliaScreen;
+    mandelbrotScreen.view = mandelbrot;
+    juliaScreen.view = julia;
+    mandelbrotScreen.rect = { mandelbrotGap, mandelbrotGap, mandelbrot.width, mandelbrot.height };
+    juliaScreen.rect = { screenWidth - julia.width - mandelbrotGap, mandelbrotGap, julia.width, julia.height };
 
     array<int, 2> mousePos = { 0, 0 };
     string activeFractal = "mandelbrot";
@@ -323,23 +452,216 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
     mandelbrotIterationText.colour = { 255, 255, 255, 255 };
     text juliaIterationText("Julia iterations: ", 300, 0, 14);
     juliaIterationText.colour = { 255, 255, 255, 255 };
+    text mandelbrotPrecisionText("Mandelbrot precision: ", 500, 0, 14);
+    mandelbrotPrecisionText.colour = { 255, 255, 255, 255 };
+    text juliaPrecisionText("Julia precision: ", 750, 0, 14);
+    juliaPrecisionText.colour = { 255, 255, 255, 255 };
+
+    // The render thread: takes the newest view snapshot, renders whatever it asks for and publishes each finished frame
+    // to its fractal's mailbox. It never waits for the UI thread, which keeps polling input and presenting at display
+    // rate whatever the renders cost.
+    mailbox<viewSnapshot> views;
+    std::atomic<bool> stopRendering(false);
+    viewSnapshot& firstViews = views.back();
+    firstViews.mandelbrot = mandelbrotScreen.view;
+    firstViews.julia = juliaScreen.view;
+    firstViews.palette = palette;
+    views.publish();
+
+    colourPalette renderPalette = palette; //the render thread's copy, the UI thread's palette changes under it
+    std::thread renderThread([&]() {
+        // Renders and colours fractalSet's next frame on the CPU, unless nothing changed
+        auto renderCpuFrame = [&](auto& fractalSet, fractalKernels& kernels) {
+            if (fractalSet.framesToUpdate == 0 && fractalSet.framesToColour == 0) { return; }
+            bool abandoned = false;
+            if (fractalSet.framesToUpdate > 0) {
+                fractalSet.setKernelArgs(kernels.compute);
+                if (fractalSet.perturbation) { fractalSet.renderPerturbation(cpuEngine); }
+                else if (fractalSet.previewing) { fractalSet.renderPreview(cpuEngine); }
+                else if (fractalSet.panning) { fractalSet.renderPan(cpuEngine); }
+                else if (fractalSet.marianiSilver) { cpuEngine.renderMarianiSilver(fractalSet.cpuArgs, fractalSet.marianiSilverGuard); }
+                else { cpuEngine.render(fractalSet.cpuArgs); }
+                if (debugInteriorStats) { fractalSet.readInteriorCounts(); }
+                if (debugMarianiSilverStats) { fractalSet.readIteratedPixels(); }
+                if (debugSkippedIterations && fractalSet.perturbation) { fractalSet.readSkippedIterations(); }
+                if (fractalSet.hasMirror()) { cpuEngine.mirror(fractalSet.cpuArgs); }
+                abandoned = fractalSet.frameAbandoned();
+                if (!fractalSet.previewing) { fractalSet.framesToUpdate--; } //a zoom preview is followed by the full render
+            }
+            if (!abandoned) {
+                fractalSet.setColourKernelArgs(kernels.colour, renderPalette);
+                cpuEngine.colour(fractalSet.cpuColour);
+                fractalSet.publishFrame();
+            }
 
+            if (fractalSet.framesToColour > 0) { fractalSet.framesToColour--; }
+        };
 
+        // Colours fractalSet's frame into the next slot of the ring
+        auto colourFrame = [&](auto& fractalSet, fractalKernels& kernels) {
+            fractalSet.setColourKernelArgs(kernels.colour, renderPalette);
+            fractalSet.enqueueColour(kernels.colour);
 
-    // Main render loop
+            if (debugInteriorStats) { fractalSet.readInteriorCounts(); }
+            if (debugMarianiSilverStats && fractalSet.marianiSilver) { fractalSet.readIteratedPixels(); }
+            if (debugSkippedIterations && fractalSet.perturbation) { fractalSet.readSkippedIterations(); }
+
+            if (fractalSet.framesToColour > 0) { fractalSet.framesToColour--; }
+        };
+
+        // Enqueues fractalSet's next frame on its own queue, without waiting for it
+        auto submitFrame = [&](auto& fractalSet, fractalKernels& kernels) {
+            // a perturbation frame is coloured once its glitch fix-up is done, which runs a pass per loop as its readback arrives
+            if (fractalSet.fixingGlitches) {
+                if (fractalSet.fixGlitchedPixels(NULL, &kernels.perturbation)) { colourFrame(fractalSet, kernels); }
+                return;
+            }
+            if (fractalSet.framesToUpdate == 0 && fractalSet.framesToColour == 0) { return; }
+
+            // Wait for a free frame slot, only if the ring is full
+            fractalSet.waitForFrameSlot();
+
+            // Execute the compute kernel, unless only the colours changed
+            if (fractalSet.framesToUpdate > 0) {
+                int tier = fractalSet.precisionTier(fractalSet.index[0], fractalSet.index[1]); //the mandelbrot set's index stays 0
+                bool useFloat = tier == tierFloat;
+                cl_kernel& computeKernel = useFloat ? kernels.floatCompute : kernels.compute;
+                fractalSet.setKernelArgs(computeKernel);
+                if (fractalSet.perturbation) {
+                    fractalSet.enqueuePerturbation(kernels.perturbation);
+                }
+                else if (fractalSet.escalating) { //double, then perturbation for the tiles it leaves unresolved
+                    fractalSet.resetGlobalIndex();
+                    clEnqueueNDRangeKernel(fractalSet.queue, computeKernel, 1, NULL, &fractalSet.globalWorkSize, &fractalSet.localWorkSize, 0, NULL, NULL);
+                    fractalSet.escalateToPerturbation(kernels.detect, kernels.perturbation);
+                }
+                else if (fractalSet.previewing) {
+                    fractalSet.enqueuePreview(computeKernel, kernels.reproject);
+                }
+                else if (fractalSet.panning) {
+                    fractalSet.enqueuePan(computeKernel, kernels.shift);
+                }
+                else if (fractalSet.marianiSilver) {
+                    fractalSet.enqueueMarianiSilver(useFloat ? kernels.floatMarianiSilver : kernels.marianiSilver);
+                }
+                else if (tier == tierMixed) {
+                    fractalSet.setComputeKernelArgs(kernels.floatCompute);
+                    fractalSet.enqueueFloatTiles(kernels.floatCompute, kernels.compute);
+                    fractalSet.escalateToDouble(kernels.floatDetect, kernels.compute);
+                }
+                else {
+                    fractalSet.resetGlobalIndex();
+                    clEnqueueNDRangeKernel(fractalSet.queue, computeKernel, 1, NULL, &fractalSet.globalWorkSize, &fractalSet.localWorkSize, 0, NULL, NULL);
+                    if (useFloat) { //the float tiles that collapse after all go to double
+                        fractalSet.setComputeKernelArgs(kernels.compute);
+                        fractalSet.escalateToDouble(kernels.floatDetect, kernels.compute);
+                    }
+                }
+                if (fractalSet.hasMirror()) {
+                    fractalSet.setMirrorKernelArgs(kernels.mirror);
+                    clEnqueueNDRangeKernel(fractalSet.queue, kernels.mirror, 1, NULL, &fractalSet.globalWorkSize, &fractalSet.localWorkSize, 0, NULL, NULL);
+                }
+                if (!fractalSet.previewing) { fractalSet.framesToUpdate--; }
+            }
+            if (fractalSet.fixingGlitches) { return; }
+            colourFrame(fractalSet, kernels);
+        };
+
+        bool juliaActive = false;
+        auto statsPoint = std::chrono::steady_clock::now();
+        while (!stopRendering.load()) {
+            // a glitch fix-up works on the view its frame was rendered for, so the next view waits for it; latestGeneration
+            // still reaches cancelStaleFrames and cuts it short
+            bool fixingGlitches = mandelbrot.fixingGlitches || julia.fixingGlitches;
+            if (viewSnapshot* snapshot = fixingGlitches ? NULL : views.take()) {
+                mandelbrot.takeView(snapshot->mandelbrot, context, device);
+                julia.takeView(snapshot->julia, context, device);
+                juliaActive = snapshot->juliaActive;
+                mandelbrot.setActive(!juliaActive, context, device);
+                julia.setActive(juliaActive, context, device);
+                if (snapshot->palette.version != renderPalette.version) { renderPalette = snapshot->palette; }
+            }
+            mandelbrot.cancelStaleFrames();
+            julia.cancelStaleFrames();
+
+            if (std::chrono::duration<double>(std::chrono::steady_clock::now() - statsPoint).count() > 1) {
+                statsPoint = std::chrono::steady_clock::now();
+
+                if (debugWorkerStats && useCpuBackend) {
+                    vector<workerStats> stats = cpuEngine.scheduler.stats();
+                    for (size_t i = 0; i < stats.size(); i++) {
+                        DBOUT("worker " << i << ": tiles " << stats[i].tilesDone << ", stolen " << stats[i].tilesStolen
+                            << ", busy " << stats[i].busyTime << "s, idle " << stats[i].idleTime << "s" << std::endl)
+                    }
+                    cpuEngine.scheduler.resetStats();
+                }
+                if (debugInteriorStats) {
+                    DBOUT("pixels finished early last frame, mandelbrot: cardioid/bulb " << mandelbrot.interiorCounts[0] << ", cycle " << mandelbrot.interiorCounts[1]
+                        << "; julia: cycle " << julia.interiorCounts[1] << std::endl)
+                }
+                if (debugMarianiSilverStats) {
+                    DBOUT("pixels iterated last frame, mandelbrot: " << mandelbrot.iteratedPixels << " of " << mandelbrot.width * mandelbrot.height
+                        << "; julia: " << julia.iteratedPixels << " of " << julia.width * julia.height << std::endl)
+                }
+                if (debugSkippedIterations) {
+                    DBOUT("iterations skipped by BLA steps last frame, mandelbrot: " << (mandelbrot.perturbation ? mandelbrot.skippedIterations : 0)
+                        << "; julia: " << (julia.perturbation ? julia.skippedIterations : 0) << std::endl)
+                }
+                if (debugGlitchStats) {
+                    DBOUT("reference orbits last frame, mandelbrot: " << (mandelbrot.perturbation ? mandelbrot.referenceCount : 0) << ", glitched pixels re-rendered " << (mandelbrot.perturbation ? mandelbrot.reRenderedPixels : 0)
+                        << "; julia: " << (julia.perturbation ? julia.referenceCount : 0) << ", re-rendered " << (julia.perturbation ? julia.reRenderedPixels : 0) << std::endl)
+                }
+            }
+
+            bool rendering = mandelbrot.framesToUpdate > 0 || mandelbrot.framesToColour > 0 || julia.framesToUpdate > 0 || julia.framesToColour > 0 || fixingGlitches;
+
+            julia.colouringScheme = mandelbrot.colouringScheme;
+            if (useCpuBackend) {
+                renderCpuFrame(mandelbrot, mandelbrotKernels);
+                renderCpuFrame(julia, juliaKernels);
+            }
+
+            // Both views reach the device before either is presented, so they render concurrently: the active view first, and on
+            // a queue with the higher priority where the device takes priority hints
+            if (!useCpuBackend) {
+                if (juliaActive) {
+                    submitFrame(julia, juliaKernels);
+                    submitFrame(mandelbrot, mandelbrotKernels);
+                }
+                else {
+                    submitFrame(mandelbrot, mandelbrotKernels);
+                    submitFrame(julia, juliaKernels);
+                }
+            }
+
+            if (!useCpuBackend) {
+                // with nothing new to submit, sleep until the oldest frame in flight arrives instead of polling for it
+                if (!rendering) {
+                    if (mandelbrot.framesInFlight > 0) { mandelbrot.waitForOldestFrame(); }
+                    else { julia.waitForOldestFrame(); }
+                }
+                mandelbrot.publishFrames();
+                julia.publishFrames();
+                rendering = rendering || mandelbrot.framesInFlight > 0 || julia.framesInFlight > 0 || mandelbrot.fixingGlitches || julia.fixingGlitches;
+            }
+            if (!rendering) { std::this_thread::sleep_for(std::chrono::milliseconds(1)); }
+        }
+    });
+
+    // Main loop: input, view snapshots for the render thread and presenting its newest frames
     bool quit = false;
     while (!quit)
     {
         frameStart = std::chrono::high_resolution_clock::now();
         SDL_GetMouseState(&mousePos[0], &mousePos[1]);
 
-        if (mousePos[0] >= mandelbrot.rect.x && mousePos[0] <= mandelbrot.width + mandelbrot.rect.x && mousePos[1] >= mandelbrot.rect.y && mousePos[1] <= mandelbrot.height + mandelbrot.rect.y && mandelbrot.width < julia.width) {
+        if (mousePos[0] >= mandelbrotScreen.rect.x && mousePos[0] <= mandelbrotScreen.rect.w + mandelbrotScreen.rect.x && mousePos[1] >= mandelbrotScreen.rect.y && mousePos[1] <= mandelbrotScreen.rect.h + mandelbrotScreen.rect.y && mandelbrotScreen.view.width < juliaScreen.view.width) {
             activeFractal = "mandelbrot";
-            swapFractalSizes(julia, mandelbrot, context, device);
+            swapFractalSizes(juliaScreen, mandelbrotScreen);
         }
-        if (mousePos[0] >= julia.rect.x && mousePos[0] <= julia.width + julia.rect.x && mousePos[1] >= julia.rect.y && mousePos[1] <= julia.height + julia.rect.y && julia.width < mandelbrot.width) {
+        if (mousePos[0] >= juliaScreen.rect.x && mousePos[0] <= juliaScreen.rect.w + juliaScreen.rect.x && mousePos[1] >= juliaScreen.rect.y && mousePos[1] <= juliaScreen.rect.h + juliaScreen.rect.y && juliaScreen.view.width < mandelbrotScreen.view.width) {
             activeFractal = "julia";
-            swapFractalSizes(julia, mandelbrot, context, device);
+            swapFractalSizes(juliaScreen, mandelbrotScreen);
         }
 
         if (timeElapsed - timerPoint > 1) {
@@ -348,54 +670,43 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
             frameCounterPoint = frameCounter;
         }
         fpsText.setText("FPS: " + to_string(fps));
-        mandelbrotIterationText.setText("Mandelbrot iterations: " + to_string(mandelbrot.maxIterations));
-        juliaIterationText.setText("Julia iterations: " + to_string(julia.maxIterations));
+        mandelbrotIterationText.setText("Mandelbrot iterations: " + to_string(mandelbrotScreen.view.maxIterations));
+        juliaIterationText.setText("Julia iterations: " + to_string(juliaScreen.view.maxIterations));
+        mandelbrotPrecisionText.setText(std::string("Mandelbrot precision: ") + precisionName(mandelbrotScreen.tier));
+        juliaPrecisionText.setText(std::string("Julia precision: ") + precisionName(juliaScreen.tier));
 
         if (activeFractal == "mandelbrot") {
-            quit = handleInput(mandelbrot, mandelbrot, julia);
+            quit = handleInput(mandelbrotScreen.view, mandelbrotScreen.view, juliaScreen.view, palette);
         }
         else {
-            quit = handleInput(julia, mandelbrot, julia);
+            quit = handleInput(juliaScreen.view, mandelbrotScreen.view, juliaScreen.view, palette);
         }
 
-        if (mandelbrot.framesToUpdate > 0) {
-            std::swap(mandelbrot.readPixelArr, mandelbrot.writePixelArr);
-            swapClMemObjects(mandelbrot.d_readPixelArr, mandelbrot.d_writePixelArr);
-
-            mandelbrot.setKernelArgs(mandelbrotKernel);
-            mandelbrot.writeBuffers();
-
-            // Transfer data from device to host
-            err = clEnqueueReadBuffer(mandelbrot.queue, mandelbrot.d_readPixelArr, CL_FALSE, 0, mandelbrot.width * mandelbrot.height * sizeof(uint32_t), mandelbrot.readPixelArr, 0, NULL, NULL);
-
-            // Execute the mandelbrot kernel
-            clEnqueueNDRangeKernel(mandelbrot.queue, mandelbrotKernel, 1, NULL, &mandelbrot.globalWorkSize, NULL, 0, NULL, NULL);
-
-            clFinish(mandelbrot.queue);
-
-            //set pixels of surface
-            memcpy(mandelbrot.surface->pixels, mandelbrot.readPixelArr, mandelbrot.width * mandelbrot.height * sizeof(uint32_t));
-            
-            mandelbrot.framesToUpdate--;
+        // hand the views to the render thread, with a new generation for each render or recolour they asked for
+        for (fractalView* view : { &mandelbrotScreen.view, &juliaScreen.view }) {
+            if (view->framesToUpdate > 0) { view->generation++; }
+            if (view->framesToColour > 0) { view->colourGeneration++; }
+            view->framesToUpdate = 0;
+            view->framesToColour = 0;
         }
-
-        if (julia.framesToUpdate > 0) {
-            swap(julia.readPixelArr, julia.writePixelArr);
-            swapClMemObjects(julia.d_readPixelArr, julia.d_writePixelArr);
-
-            julia.colouringScheme = mandelbrot.colouringScheme;
-            julia.setKernelArgs(juliaKernel);
-            julia.writeBuffers();
-
-            err = clEnqueueReadBuffer(julia.queue, julia.d_readPixelArr, CL_FALSE, 0, julia.width * julia.height * sizeof(uint32_t), julia.readPixelArr, 0, NULL, NULL);
-
-            clEnqueueNDRangeKernel(julia.queue, juliaKernel, 1, NULL, &julia.globalWorkSize, NULL, 0, NULL, NULL);
-
-            memcpy(julia.surface->pixels, julia.readPixelArr, julia.width * julia.height * sizeof(uint32_t));
-
-            clFinish(julia.queue);
-
-            julia.framesToUpdate--;
+        // straight to the fractals too, so that the render thread's work on older views stops before the snapshot arrives
+        mandelbrot.latestGeneration = mandelbrotScreen.view.generation;
+        julia.latestGeneration = juliaScreen.view.generation;
+        viewSnapshot& snapshot = views.back();
+        snapshot.mandelbrot = mandelbrotScreen.view;
+        snapshot.julia = juliaScreen.view;
+        snapshot.juliaActive = activeFractal == "julia";
+        if (snapshot.palette.version != palette.version) { snapshot.palette = palette; }
+        views.publish();
+
+        // set pixels of the textures from the newest frames the render thread finished, which may unmap them after that
+        if (finishedFrame* frame = mandelbrot.frames.take()) {
+            mandelbrotScreen.show(*frame);
+            frame->shown = true;
+        }
+        if (finishedFrame* frame = julia.frames.take()) {
+            juliaScreen.show(*frame);
+            frame->shown = true;
         }
 
         if (frameRateCap != -1) {
@@ -409,15 +720,14 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 
         SDL_RenderClear(renderer);
 
-        SDL_UpdateTexture(mandelbrot.texture, NULL, mandelbrot.surface->pixels, mandelbrot.surface->pitch);
-        SDL_UpdateTexture(julia.texture, NULL, julia.surface->pixels, julia.surface->pitch);
-
         SDL_RenderCopy(renderer, backgroundTexture, NULL, NULL);
-        SDL_RenderCopy(renderer, mandelbrot.texture, NULL, &mandelbrot.rect);
-        SDL_RenderCopy(renderer, julia.texture, NULL, &julia.rect);
+        SDL_RenderCopy(renderer, mandelbrotScreen.texture, NULL, &mandelbrotScreen.rect);
+        SDL_RenderCopy(renderer, juliaScreen.texture, NULL, &juliaScreen.rect);
         SDL_RenderCopy(renderer, fpsText.texture, nullptr, &fpsText.rect);
         SDL_RenderCopy(renderer, mandelbrotIterationText.texture, nullptr, &mandelbrotIterationText.rect);
         SDL_RenderCopy(renderer, juliaIterationText.texture, nullptr, &juliaIterationText.rect);
+        SDL_RenderCopy(renderer, mandelbrotPrecisionText.texture, nullptr, &mandelbrotPrecisionText.rect);
+        SDL_RenderCopy(renderer, juliaPrecisionText.texture, nullptr, &juliaPrecisionText.rect);
 
         SDL_RenderPresent(renderer);
 
@@ -427,16 +737,24 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
         timeElapsed += deltaTime;
     }
 
+    mandelbrot.showing = false; //no more frames are taken, so the render thread must not wait for them to be shown
+    julia.showing = false;
+    stopRendering = true;
+    renderThread.join();
+
     delete[] devices;
     delete[] platforms;
-    delete[] buildLog;
 
-    clReleaseKernel(mandelbrotKernel);
-    clReleaseKernel(juliaKernel);
-    clReleaseProgram(mandelbrotProgram);
-    clReleaseProgram(juliaProgram);
+    if (!useCpuBackend) {
+        mandelbrotKernels.release();
+        juliaKernels.release();
+        clReleaseProgram(mandelbrotProgram);
+        clReleaseProgram(juliaProgram);
+        clReleaseProgram(mandelbrotFloatProgram);
+        clReleaseProgram(juliaFloatProgram);
 
-    clReleaseContext(context);
+        clReleaseContext(context);
+    }
 
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
@@ -445,4 +763,11 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
     SDL_Quit();
 
     return 0;
-}
\ No newline at end of file
+}
+
+#ifndef _WIN32
+int main(int, char*[])
+{
+    return WinMain(NULL, NULL, NULL, 0);
+}
+#endif
@@ -0,0 +1,199 @@
+#pragma once
+#include <CL/cl.h>
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+#include "fractals.h"
+
+// Renders the fractal's current view with per-pixel and with tile work claiming at a range of
+// maxIterations settings and prints the average frame time of each.
+template <class fractalType>
+void benchmarkWorkClaiming(fractalType& fractalSet, cl_kernel& kernel, const char* name) {
+    const int iterationSettings[] = { 64, 256, 1024, 4096, 16384 };
+    const int repeats = 10;
+    int savedIterations = fractalSet.maxIterations;
+    int savedClaiming = fractalSet.tileClaiming;
+    bool savedContinuation = fractalSet.continueIterations;
+    fractalSet.continueIterations = false; //every frame must be a full render
+    bool savedFloat = fractalSet.allowFloat;
+    fractalSet.allowFloat = false; //kernel is the double build, which leaves the float tiles to the other one
+
+    std::ostringstream report;
+    report << name << " work claiming benchmark, " << fractalSet.width << "x" << fractalSet.height << ", ms per frame\n";
+    report << std::setw(14) << "maxIterations" << std::setw(12) << "per-pixel" << std::setw(12) << "tiles" << std::setw(10) << "speedup" << "\n";
+    for (int maxIterations : iterationSettings) {
+        double frameTime[2];
+        for (int mode = 0; mode < 2; mode++) {
+            fractalSet.maxIterations = maxIterations;
+            fractalSet.tileClaiming = mode;
+            fractalSet.setKernelArgs(kernel);
+
+            // warm up, the first dispatch includes the kernel's compilation on some drivers
+            fractalSet.resetGlobalIndex();
+            clEnqueueNDRangeKernel(fractalSet.queue, kernel, 1, NULL, &fractalSet.globalWorkSize, &fractalSet.localWorkSize, 0, NULL, NULL);
+            clFinish(fractalSet.queue);
+
+            auto start = std::chrono::high_resolution_clock::now();
+            for (int i = 0; i < repeats; i++) {
+                fractalSet.resetGlobalIndex();
+                clEnqueueNDRangeKernel(fractalSet.queue, kernel, 1, NULL, &fractalSet.globalWorkSize, &fractalSet.localWorkSize, 0, NULL, NULL);
+                clFinish(fractalSet.queue);
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            frameTime[mode] = std::chrono::duration<double, std::milli>(end - start).count() / repeats;
+        }
+        report << std::setw(14) << maxIterations << std::fixed << std::setprecision(3)
+            << std::setw(12) << frameTime[0] << std::setw(12) << frameTime[1]
+            << std::setw(9) << frameTime[0] / frameTime[1] << "x\n";
+    }
+
+    fractalSet.maxIterations = savedIterations;
+    fractalSet.tileClaiming = savedClaiming;
+    fractalSet.continueIterations = savedContinuation;
+    fractalSet.allowFloat = savedFloat;
+    std::cout << report.str();
+    DBOUT(report.str().c_str())
+}
+
+// Karatsuba multiplication, kept only to measure against fixedPoint's truncated schoolbook products: up to
+// fixedPointMaxLimbs those stay ahead, so reference orbits don't use it. The helpers work on plain integers, limbs least
+// significant first, and keep the whole product.
+
+const int karatsubaBaseLimbs = 32; //Karatsuba's halves are multiplied schoolbook below this
+const int karatsubaScratchLimbs = 4 * fixedPointMaxLimbs + 64; //4(n/2 + 1) per level, summed over the levels
+
+// r[0, 2n) = a[0, n) * b[0, n); a == b squares, taking every cross product once and doubling it.
+inline void schoolbookProduct(const uint32_t* a, const uint32_t* b, int n, uint32_t* r) {
+    std::fill(r, r + 2 * n, 0);
+    bool squaring = a == b;
+    for (int i = 0; i < n; i++) {
+        uint64_t carry = 0;
+        for (int j = squaring ? i + 1 : 0; j < n; j++) {
+            uint64_t product = (uint64_t)a[i] * b[j] + r[i + j] + carry;
+            r[i + j] = (uint32_t)product;
+            carry = product >> 32;
+        }
+        r[i + n] = (uint32_t)carry;
+    }
+    if (!squaring) { return; }
+    uint64_t carry = 0;
+    for (int k = 0; k < 2 * n; k++) {
+        uint64_t sum = ((uint64_t)r[k] << 1) + carry;
+        uint64_t diagonal = (uint64_t)a[k / 2] * a[k / 2];
+        sum += k % 2 == 0 ? (uint32_t)diagonal : diagonal >> 32;
+        r[k] = (uint32_t)sum;
+        carry = sum >> 32;
+    }
+}
+
+// r[0, n) += a[0, m) for m <= n, returns the carry out of r[n - 1]
+inline uint32_t addLimbs(uint32_t* r, int n, const uint32_t* a, int m) {
+    uint64_t carry = 0;
+    for (int i = 0; i < n && (i < m || carry != 0); i++) {
+        uint64_t sum = (uint64_t)r[i] + (i < m ? a[i] : 0) + carry;
+        r[i] = (uint32_t)sum;
+        carry = sum >> 32;
+    }
+    return (uint32_t)carry;
+}
+
+// r[0, n) -= a[0, m) for m <= n, the result must not be negative
+inline void subtractLimbs(uint32_t* r, int n, const uint32_t* a, int m) {
+    int64_t borrow = 0;
+    for (int i = 0; i < n && (i < m || borrow != 0); i++) {
+        int64_t difference = (int64_t)r[i] - (i < m ? a[i] : 0) - borrow;
+        borrow = difference < 0;
+        r[i] = (uint32_t)(difference + (borrow << 32));
+    }
+}
+
+// r[0, 2n) = a[0, n) * b[0, n) by Karatsuba: with a = a1 B + a0 and b = b1 B + b0, the middle term a1 b0 + a0 b1 is
+// (a0 + a1)(b0 + b1) - a0 b0 - a1 b1, three half-size products instead of four. a == b squares. scratch holds
+// karatsubaScratchLimbs.
+inline void karatsubaProduct(const uint32_t* a, const uint32_t* b, int n, uint32_t* r, uint32_t* scratch) {
+    if (n < karatsubaBaseLimbs) {
+        schoolbookProduct(a, b, n, r);
+        return;
+    }
+    int low = n / 2;
+    int high = n - low; //high >= low, the sums of the halves take high + 1 limbs
+    karatsubaProduct(a, b, low, r, scratch);
+    karatsubaProduct(a + low, b + low, high, r + 2 * low, scratch);
+    uint32_t* sumA = scratch;
+    uint32_t* sumB = a == b ? sumA : scratch + high + 1;
+    uint32_t* middle = scratch + 2 * (high + 1);
+    std::copy(a + low, a + n, sumA);
+    sumA[high] = addLimbs(sumA, high, a, low);
+    if (sumB != sumA) {
+        std::copy(b + low, b + n, sumB);
+        sumB[high] = addLimbs(sumB, high, b, low);
+    }
+    karatsubaProduct(sumA, sumB, high + 1, middle, middle + 2 * (high + 1));
+    subtractLimbs(middle, 2 * (high + 1), r, 2 * low);
+    subtractLimbs(middle, 2 * (high + 1), r + 2 * low, 2 * high);
+    addLimbs(r + low, 2 * n - low, middle, 2 * high + 1); //the middle term is below B^(2 high + 1)
+}
+
+// fixedPoint::multiply (or square, with &a == &b) by karatsubaProduct: it computes the whole product, O(n^1.585) limb
+// products against multiply's n^2 / 2, and drops the columns past the truncation afterwards. result may alias a or b.
+inline void multiplyKaratsuba(const fixedPoint& a, const fixedPoint& b, fixedPoint& result) {
+    int limbs = (std::max)(a.limbs, b.limbs);
+    uint32_t x[fixedPointMaxLimbs];
+    uint32_t y[fixedPointMaxLimbs];
+    uint32_t product[2 * fixedPointMaxLimbs];
+    uint32_t scratch[karatsubaScratchLimbs];
+    // limb i of a fixedPoint has weight 2^(-32i), so its column i + j of the product lands at 2 limbs - 2 - i - j
+    for (int i = 0; i < limbs; i++) {
+        x[limbs - 1 - i] = i < a.limbs ? a.limb[i] : 0;
+        y[limbs - 1 - i] = i < b.limbs ? b.limb[i] : 0;
+    }
+    karatsubaProduct(x, &a == &b ? x : y, limbs, product, scratch);
+    bool negative = a.negative != b.negative;
+    // product[2 limbs - 1] is overflow past the integer limb, dropped like multiply does
+    for (int i = 0; i < limbs; i++) { result.limb[i] = product[2 * limbs - 2 - i]; }
+    result.limbs = limbs;
+    result.negative = negative;
+    if (result.isZero()) { result.negative = false; }
+}
+
+// Times fixedPoint's schoolbook multiply and square against multiplyKaratsuba doing the same at the precisions reference
+// orbits use, 128 bits up to fixedPointMaxLimbs, and prints the nanoseconds per operation of each.
+inline void benchmarkFixedPoint() {
+    const int bitSettings[] = { 128, 256, 512, 1024, 2048, 4096 };
+    std::ostringstream report;
+    report << "fixed point multiplication benchmark, ns per operation\n";
+    report << std::setw(8) << "bits" << std::setw(12) << "multiply" << std::setw(12) << "Karatsuba" << std::setw(12) << "square" << std::setw(12) << "Karatsuba" << "\n";
+    for (int bits : bitSettings) {
+        fixedPoint a;
+        a.setPrecision((std::min)(1 + bits / 32, fixedPointMaxLimbs));
+        // a value like an orbit point, with every fractional limb in use
+        uint32_t seed = 12345;
+        for (int i = 1; i < a.limbs; i++) { a.limb[i] = seed = seed * 1664525 + 1013904223; }
+        a.limb[0] = 1;
+        fixedPoint b = a;
+        b.limb[1] ^= 7;
+        int repeats = 20000000 / (a.limbs * a.limbs) + 1000;
+
+        double time[4];
+        for (int mode = 0; mode < 4; mode++) {
+            fixedPoint result;
+            uint32_t check = 0; //keeps the loop from being optimised away
+            auto start = std::chrono::high_resolution_clock::now();
+            for (int i = 0; i < repeats; i++) {
+                if (mode == 0) { fixedPoint::multiply(a, b, result); }
+                else if (mode == 1) { multiplyKaratsuba(a, b, result); }
+                else if (mode == 2) { fixedPoint::square(a, result); }
+                else { multiplyKaratsuba(a, a, result); }
+                check += result.limb[a.limbs - 1];
+                a.limb[a.limbs - 1] ^= check & 1;
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            time[mode] = std::chrono::duration<double, std::nano>(end - start).count() / repeats;
+        }
+        // the last row is capped at fixedPointMaxLimbs, print what was measured
+        report << std::setw(8) << 32 * (a.limbs - 1) << std::fixed << std::setprecision(1)
+            << std::setw(12) << time[0] << std::setw(12) << time[1] << std::setw(12) << time[2] << std::setw(12) << time[3] << "\n";
+    }
+    std::cout << report.str();
+    DBOUT(report.str().c_str())
+}
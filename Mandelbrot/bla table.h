@@ -0,0 +1,101 @@
+#pragma once
+
+// Bivariate linear approximation of perturbed iteration: while d is tiny next to the reference orbit Z, the d^2 term of
+// d = (2 Z + d) d + dc hardly matters, and l steps collapse into d = A d + B dc. A pixel whose d is inside a step's radius
+// skips all l iterations with one complex multiply-add. The radius bounds the dropped d^2 terms to epsilon times the kept
+// ones for every dc within dcMax of the reference, so it holds for the whole frame.
+// Steps of length 2^k start at iterations 1, 1 + 2^k, 1 + 2 * 2^k, ... and are stored level by level, k = 1, 2, ...;
+// level k has (referenceLength - 2) >> k of them, so the table is about as long as the orbit.
+
+#include <vector>
+#include <cmath>
+#include <climits>
+#include <algorithm>
+#include <utility>
+#include "float exp.h"
+#include "reference orbit.h"
+
+const int blaMaxLevels = 24; //longest skip is 2^24 iterations
+const int blaCoefficientLimit = 1000; //steps whose A or B reach 2^1000 are never taken, so A d + B dc can't overflow
+
+// same layout as blaStep in the kernels
+struct blaStep {
+    double aReal; //d is multiplied by A
+    double aImag;
+    double bReal; //and dc by B, 0 for julia sets
+    double bImag;
+    double radius; //valid while |d| < radius, 0 if the radius is below what a double holds
+    int radiusExponent; //radius >= 2^radiusExponent, INT_MIN for a step that is never valid; for d deeper than doubles reach
+};
+
+struct blaTable {
+    std::vector<blaStep> steps;
+    std::vector<floatExp> radii; //exact radii of steps, the next level is merged from them
+    int levels = 0; //0 if the orbit is too short to skip anything
+    floatExp dcMax = -1; //bound on |dc| the radii were computed for
+    double epsilon = 0;
+
+    // Rebuilds the table for orbit, with radii that hold for |dc| <= newDcMax.
+    void build(const referenceOrbit& orbit, const floatExp& newDcMax, double newEpsilon) {
+        dcMax = newDcMax;
+        epsilon = newEpsilon;
+        steps.clear();
+        radii.clear();
+        levels = 0;
+        int count = orbit.length() - 2; //single steps, from iteration 1 to the end of the orbit
+        if (count < 2) { return; }
+
+        // level 1 straight from pairs of single steps, which are only ever needed here
+        for (int i = 0; i < count >> 1; i++) {
+            floatExp xRadius, yRadius;
+            blaStep x = singleStep(orbit, 1 + 2 * i, xRadius);
+            blaStep y = singleStep(orbit, 2 + 2 * i, yRadius);
+            push(merge(x, xRadius, y, yRadius));
+        }
+        levels = 1;
+        size_t previous = 0;
+        while (levels < blaMaxLevels && count >> (levels + 1) > 0) {
+            size_t start = steps.size();
+            for (int i = 0; i < count >> (levels + 1); i++) {
+                size_t x = previous + 2 * i;
+                push(merge(steps[x], radii[x], steps[x + 1], radii[x + 1]));
+            }
+            previous = start;
+            levels++;
+        }
+    }
+
+    // d = 2 Z d + dc from iteration to iteration + 1, valid while |d| < epsilon |2 Z|. Past |Z| = 2 the reference is
+    // escaping and the pixel has to check every iteration for its own escape, so those steps are never skipped.
+    blaStep singleStep(const referenceOrbit& orbit, int iteration, floatExp& radius) const {
+        double zReal = orbit.points[2 * iteration];
+        double zImag = orbit.points[2 * iteration + 1];
+        double magnitude = sqrt(zReal * zReal + zImag * zImag);
+        radius = magnitude > 2 ? 0 : epsilon * 2 * magnitude;
+        blaStep step = { 2 * zReal, 2 * zImag, orbit.julia ? 0.0 : 1.0, 0, 0, 0 };
+        return step;
+    }
+
+    // x followed by y: d = A_y (A_x d + B_x dc) + B_y dc, valid while |d| < radius_x and the result of x is within radius_y
+    std::pair<blaStep, floatExp> merge(const blaStep& x, const floatExp& xRadius, const blaStep& y, const floatExp& yRadius) const {
+        blaStep result = {};
+        result.aReal = y.aReal * x.aReal - y.aImag * x.aImag;
+        result.aImag = y.aReal * x.aImag + y.aImag * x.aReal;
+        result.bReal = y.aReal * x.bReal - y.aImag * x.bImag + y.bReal;
+        result.bImag = y.aReal * x.bImag + y.aImag * x.bReal + y.bImag;
+        floatExp limit = yRadius - hypot(x.bReal, x.bImag) * dcMax;
+        double xScale = hypot(x.aReal, x.aImag);
+        floatExp radius = limit <= 0 ? 0 : xScale == 0 ? xRadius : (std::min)(xRadius, limit / xScale); //after A = 0 any d lands at B_x dc
+        if (!(hypot(result.aReal, result.aImag) < ldexp(1.0, blaCoefficientLimit) && hypot(result.bReal, result.bImag) < ldexp(1.0, blaCoefficientLimit))) { radius = 0; }
+        return std::make_pair(result, radius);
+    }
+
+    void push(std::pair<blaStep, floatExp> merged) {
+        const floatExp& radius = merged.second;
+        merged.first.radius = (double)radius;
+        // the mantissa is at least 0.5, so radius >= 2^(exponent - 1)
+        merged.first.radiusExponent = radius.mantissa > 0 ? radius.exponent - 1 : INT_MIN;
+        steps.push_back(merged.first);
+        radii.push_back(radius);
+    }
+};
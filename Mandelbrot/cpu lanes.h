@@ -0,0 +1,242 @@
+// Lane-refilling escape-time loop shared by every SIMD path of the CPU renderer.
+// This file is included once per instruction set from "cpu renderer.h", inside a namespace
+// that defines doubleLanes/floatLanes for that instruction set, so it has no include guard.
+
+// Everything a lane needs to carry between iterations, laid out so a lane can be swapped out
+// with plain array writes whenever its pixel finishes.
+template <class V>
+struct laneState {
+    typedef typename V::real real;
+    alignas(64) real zReal[V::width];
+    alignas(64) real zImag[V::width];
+    alignas(64) real cReal[V::width];
+    alignas(64) real cImag[V::width];
+    alignas(64) real derReal[V::width];
+    alignas(64) real derImag[V::width];
+    alignas(64) real zOldReal[V::width];
+    alignas(64) real zOldImag[V::width];
+    alignas(64) real iteration[V::width];
+    alignas(64) real snapshotAt[V::width]; //next power of two iteration, where zOld is replaced by z
+    int pixelIndex[V::width];
+    int bulbPixels = 0;
+    int cyclePixels = 0;
+    int iteratedPixels = 0;
+};
+
+// Smallest power of two above iteration, the next point the cycle check takes a snapshot at.
+inline int nextSnapshot(int iteration) {
+    int power = 1;
+    while (power <= iteration) { power *= 2; }
+    return power;
+}
+
+// Loads the next pixel of the tile that still needs iterating into the lane, or parks the lane
+// on c = 0 when the tile is used up. Returns false for a parked lane. Pixels whose stored state is
+// already final when resuming, or that lie in the main cardioid or period-2 bulb, are finished
+// here and never take a lane. Pixels an earlier Mariani-Silver step already iterated are skipped.
+template <class V>
+inline bool refillLane(laneState<V>& s, int lane, const cpuKernelArgs& args, const pixelTile& tile, int& next) {
+    typedef typename V::real real;
+    while (next < tile.width * tile.height) {
+        int pixelX = tile.x + next % tile.width;
+        int pixelY = tile.y + next / tile.width;
+        next++;
+        if (insideTile(args.copyRect, pixelX, pixelY)) { continue; } //left to the mirror pass
+        int pixelIndex = pixelY * args.screenWidth + pixelX;
+        if (args.iterationCounts && args.iterationCounts[pixelIndex] >= 0) { continue; }
+        s.iteratedPixels++;
+        double pointReal, pointImag;
+        pixelToPlane(args, pixelIndex, pointReal, pointImag);
+        if (args.julia) {
+            s.cReal[lane] = (real)args.cX;
+            s.cImag[lane] = (real)args.cY;
+        }
+        else {
+            s.cReal[lane] = (real)pointReal;
+            s.cImag[lane] = (real)pointImag;
+        }
+        s.pixelIndex[lane] = pixelIndex;
+
+        if (args.stateMode == stateResume) {
+            const pixelState& stored = args.state[pixelIndex];
+            if (stored.iteration < 0 || stored.iteration < args.previousMaxIterations) {
+                int iteration = stored.iteration < 0 ? args.maxIterations : stored.iteration;
+                args.gBuffer[pixelIndex] = shadePixel(args, iteration, stored.zReal, stored.zImag, stored.derReal, stored.derImag);
+                if (args.iterationCounts) { args.iterationCounts[pixelIndex] = iteration; }
+                continue;
+            }
+            // stopped at the old cap, undo the increment that failed the loop condition and carry on
+            s.zReal[lane] = (real)stored.zReal;
+            s.zImag[lane] = (real)stored.zImag;
+            s.derReal[lane] = (real)stored.derReal;
+            s.derImag[lane] = (real)stored.derImag;
+            s.zOldReal[lane] = (real)stored.zOldReal;
+            s.zOldImag[lane] = (real)stored.zOldImag;
+            s.iteration[lane] = (real)(stored.iteration - 1);
+            s.snapshotAt[lane] = (real)nextSnapshot(stored.iteration - 1);
+            return true;
+        }
+
+        if (!args.julia && insideMainBulbs(pointReal, pointImag)) {
+            args.gBuffer[pixelIndex] = shadePixel(args, args.maxIterations, 0, 0, 0, 0);
+            if (args.stateMode != stateNone) { args.state[pixelIndex].iteration = -1; }
+            if (args.iterationCounts) { args.iterationCounts[pixelIndex] = args.maxIterations; }
+            s.bulbPixels++;
+            continue;
+        }
+
+        s.zReal[lane] = args.julia ? (real)pointReal : 0;
+        s.zImag[lane] = args.julia ? (real)pointImag : 0;
+        s.derReal[lane] = 1;
+        s.derImag[lane] = 0;
+        s.zOldReal[lane] = 0;
+        s.zOldImag[lane] = 0;
+        s.iteration[lane] = 0;
+        s.snapshotAt[lane] = 1;
+        return true;
+    }
+    s.zReal[lane] = s.zImag[lane] = s.cReal[lane] = s.cImag[lane] = 0;
+    s.derReal[lane] = 1;
+    s.derImag[lane] = 0;
+    s.zOldReal[lane] = s.zOldImag[lane] = 0;
+    s.iteration[lane] = 0;
+    s.snapshotAt[lane] = 1;
+    s.pixelIndex[lane] = -1;
+    return false;
+}
+
+// Writes a finished lane's G-buffer entry, and its state and iteration count when the fractal keeps them.
+template <class V>
+inline void retireLane(const laneState<V>& s, int lane, const cpuKernelArgs& args, int iteration, bool cycled) {
+    int pixelIndex = s.pixelIndex[lane];
+    if (cycled) {
+        args.gBuffer[pixelIndex] = shadePixel(args, args.maxIterations, 0, 0, 0, 0);
+    }
+    else {
+        args.gBuffer[pixelIndex] = shadePixel(args, iteration, s.zReal[lane], s.zImag[lane], s.derReal[lane], s.derImag[lane]);
+    }
+    if (args.iterationCounts) { args.iterationCounts[pixelIndex] = iteration; }
+    if (args.stateMode != stateNone) {
+        pixelState& stored = args.state[pixelIndex];
+        stored.zReal = s.zReal[lane];
+        stored.zImag = s.zImag[lane];
+        stored.derReal = s.derReal[lane];
+        stored.derImag = s.derImag[lane];
+        stored.zOldReal = s.zOldReal[lane];
+        stored.zOldImag = s.zOldImag[lane];
+        stored.iteration = cycled ? -1 : iteration;
+    }
+}
+
+// Same iteration as mandelbrotKernel/juliaKernel, W pixels at a time. Lanes whose pixel escapes,
+// reaches maxIterations or is caught by the cycle check are written out and immediately
+// refilled from the tile, so no lane idles until the tile runs dry. The derivative is always
+// carried so the colour pass can switch to the lighting scheme without iterating again.
+template <class V>
+void iteratePixels(const cpuKernelArgs& args, const pixelTile& tile) {
+    typedef typename V::reg reg;
+    typedef typename V::mask mask;
+    const int W = V::width;
+
+    laneState<V> s;
+    int next = 0;
+    int liveBits = 0;
+    for (int lane = 0; lane < W; lane++) {
+        if (refillLane(s, lane, args, tile, next)) { liveBits |= 1 << lane; }
+    }
+
+    const reg boundedThreshold = V::set1(8 * 8);
+    const reg maxIterations = V::set1(args.maxIterations);
+    const reg zero = V::set1(0);
+    const reg one = V::set1(1);
+    const reg dcReal = V::set1(args.julia ? 0 : 1); //julia sets differentiate by z0, c is fixed
+    const reg two = V::set1(2);
+    const reg cycleTolerance2 = V::set1(args.cycleTolerance * args.cycleTolerance);
+
+    reg zReal = V::load(s.zReal), zImag = V::load(s.zImag);
+    reg cReal = V::load(s.cReal), cImag = V::load(s.cImag);
+    reg derReal = V::load(s.derReal), derImag = V::load(s.derImag);
+    reg zOldReal = V::load(s.zOldReal), zOldImag = V::load(s.zOldImag);
+    reg iteration = V::load(s.iteration), snapshotAt = V::load(s.snapshotAt);
+
+    while (liveBits) {
+        // while (|z|^2 < boundedThreshold && ++iteration < maxIterations)
+        reg magnitude = V::add(V::mul(zReal, zReal), V::mul(zImag, zImag));
+        mask escaped = V::notLess(magnitude, boundedThreshold);
+        reg nextIteration = V::add(iteration, one);
+        mask capped = V::notLess(nextIteration, maxIterations);
+        int doneBits = V::bits(V::maskOr(escaped, capped)) & liveBits;
+        if (doneBits) {
+            int escapedBits = V::bits(escaped);
+            V::store(s.zReal, zReal); V::store(s.zImag, zImag);
+            V::store(s.cReal, cReal); V::store(s.cImag, cImag);
+            V::store(s.derReal, derReal); V::store(s.derImag, derImag);
+            V::store(s.zOldReal, zOldReal); V::store(s.zOldImag, zOldImag);
+            V::store(s.iteration, iteration); V::store(s.snapshotAt, snapshotAt);
+            for (int lane = 0; lane < W; lane++) {
+                if (!(doneBits & (1 << lane))) { continue; }
+                int finalIteration = (int)s.iteration[lane] + ((escapedBits & (1 << lane)) ? 0 : 1);
+                retireLane(s, lane, args, finalIteration, false);
+                if (!refillLane(s, lane, args, tile, next)) { liveBits &= ~(1 << lane); }
+            }
+            zReal = V::load(s.zReal); zImag = V::load(s.zImag);
+            cReal = V::load(s.cReal); cImag = V::load(s.cImag);
+            derReal = V::load(s.derReal); derImag = V::load(s.derImag);
+            zOldReal = V::load(s.zOldReal); zOldImag = V::load(s.zOldImag);
+            iteration = V::load(s.iteration); snapshotAt = V::load(s.snapshotAt);
+            continue;
+        }
+        iteration = nextIteration;
+
+        // der = der*2*z + dc
+        reg derTemp = V::add(V::mul(V::add(V::mul(derReal, zImag), V::mul(derImag, zReal)), two), zero);
+        derReal = V::add(V::mul(V::sub(V::mul(derReal, zReal), V::mul(derImag, zImag)), two), dcReal);
+        derImag = derTemp;
+
+        // z = z^2 + c
+        reg temp = V::add(V::mul(V::mul(two, zReal), zImag), cImag);
+        zReal = V::add(V::sub(V::mul(zReal, zReal), V::mul(zImag, zImag)), cReal);
+        zImag = temp;
+
+        // Brent-style cycle check against the orbit point at the last power of two iteration
+        reg dReal = V::sub(zReal, zOldReal);
+        reg dImag = V::sub(zImag, zOldImag);
+        mask cycled = V::lessEqual(V::add(V::mul(dReal, dReal), V::mul(dImag, dImag)), cycleTolerance2);
+
+        mask snapshot = V::equal(iteration, snapshotAt);
+        snapshotAt = V::select(snapshot, V::add(snapshotAt, snapshotAt), snapshotAt);
+        zOldReal = V::select(snapshot, zReal, zOldReal);
+        zOldImag = V::select(snapshot, zImag, zOldImag);
+
+        int cycledBits = V::bits(cycled) & liveBits;
+        if (cycledBits) {
+            V::store(s.zReal, zReal); V::store(s.zImag, zImag);
+            V::store(s.cReal, cReal); V::store(s.cImag, cImag);
+            V::store(s.derReal, derReal); V::store(s.derImag, derImag);
+            V::store(s.zOldReal, zOldReal); V::store(s.zOldImag, zOldImag);
+            V::store(s.iteration, iteration); V::store(s.snapshotAt, snapshotAt);
+            for (int lane = 0; lane < W; lane++) {
+                if (!(cycledBits & (1 << lane))) { continue; }
+                retireLane(s, lane, args, args.maxIterations, true);
+                s.cyclePixels++;
+                if (!refillLane(s, lane, args, tile, next)) { liveBits &= ~(1 << lane); }
+            }
+            zReal = V::load(s.zReal); zImag = V::load(s.zImag);
+            cReal = V::load(s.cReal); cImag = V::load(s.cImag);
+            derReal = V::load(s.derReal); derImag = V::load(s.derImag);
+            zOldReal = V::load(s.zOldReal); zOldImag = V::load(s.zOldImag);
+            iteration = V::load(s.iteration); snapshotAt = V::load(s.snapshotAt);
+        }
+    }
+
+    if (args.interiorCounts) {
+        args.interiorCounts[0] += s.bulbPixels;
+        args.interiorCounts[1] += s.cyclePixels;
+    }
+    if (args.iteratedPixels) { *args.iteratedPixels += s.iteratedPixels; }
+}
+
+inline void renderTile(const cpuKernelArgs& args, const pixelTile& tile, bool useFloat) {
+    if (useFloat) { iteratePixels<floatLanes>(args, tile); }
+    else { iteratePixels<doubleLanes>(args, tile); }
+}
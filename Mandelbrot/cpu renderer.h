@@ -0,0 +1,906 @@
+#pragma once
+
+// Native escape-time renderer used when no OpenCL GPU is available (or forceCpuBackend is set).
+// It mirrors mandelbrotKernel/juliaKernel/colourKernel pixel for pixel; the fractal fills a
+// cpuKernelArgs in setKernelArgs and a cpuColourArgs in setColourKernelArgs exactly like it sets
+// the OpenCL kernel arguments.
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <cfloat>
+#include <climits>
+#include <algorithm>
+#include <atomic>
+#include "tile scheduler.h"
+#include "palette.h"
+#include "bla table.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CPU_RENDERER_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#else
+#define CPU_RENDERER_X86 0
+#endif
+
+// Iteration state of one pixel, kept so that raising maxIterations on an unchanged view carries
+// on from where each pixel stopped. Layout matches pixelState in the kernels.
+// iteration: final count if the pixel escaped, the old maxIterations if it hit the cap and -1 if
+// it is known to be interior (cycle detection or the cardioid/bulb test).
+struct pixelState {
+    double zReal;
+    double zImag;
+    double derReal;
+    double derImag;
+    double zOldReal;
+    double zOldImag;
+    int iteration;
+};
+
+enum pixelStateMode { stateNone = 0, stateWrite = 1, stateResume = 2 };
+
+// Everything the colour pass needs of a finished pixel, so palette and lighting changes never
+// re-run the iteration. Layout matches gBufferPixel in the kernels.
+struct gBufferPixel {
+    float smoothIteration; //iteration + 2 - log2(log|z|^2)
+    float magnitude; //|z|^2 where the pixel stopped
+    float normalAngle; //arg(z/der), the direction the lighting scheme shades with
+    int interior; //1 if the pixel reached maxIterations or was caught by the period check
+};
+
+// Rectangle of pixels rendered as one unit of work.
+struct pixelTile {
+    int x = 0;
+    int y = 0;
+    int width = 0;
+    int height = 0;
+};
+
+inline bool insideTile(const pixelTile& tile, int x, int y) {
+    return x >= tile.x && x < tile.x + tile.width && y >= tile.y && y < tile.y + tile.height;
+}
+
+// The parts of tile outside cut: the rows above and below it and the columns beside it, at most four tiles.
+inline int clipTile(const pixelTile& tile, const pixelTile& cut, pixelTile* pieces) {
+    int left = (std::max)(tile.x, cut.x);
+    int right = (std::min)(tile.x + tile.width, cut.x + cut.width);
+    int top = (std::max)(tile.y, cut.y);
+    int bottom = (std::min)(tile.y + tile.height, cut.y + cut.height);
+    if (left >= right || top >= bottom) {
+        pieces[0] = tile;
+        return 1;
+    }
+    int count = 0;
+    pixelTile piece;
+    if (top > tile.y) { piece.x = tile.x; piece.y = tile.y; piece.width = tile.width; piece.height = top - tile.y; pieces[count++] = piece; }
+    if (bottom < tile.y + tile.height) { piece.x = tile.x; piece.y = bottom; piece.width = tile.width; piece.height = tile.y + tile.height - bottom; pieces[count++] = piece; }
+    if (left > tile.x) { piece.x = tile.x; piece.y = top; piece.width = left - tile.x; piece.height = bottom - top; pieces[count++] = piece; }
+    if (right < tile.x + tile.width) { piece.x = right; piece.y = top; piece.width = tile.x + tile.width - right; piece.height = bottom - top; pieces[count++] = piece; }
+    return count;
+}
+
+const int marianiSilverBlockSize = 64; //side of the first Mariani-Silver rectangles, matches MS_BLOCK_SIZE in the kernels
+const int marianiSilverSplitSize = 8; //rectangles this narrow or short are iterated in full instead of being split again
+const int extendedRangeExponent = -960; //views deeper than doubles reach keep d scaled while it is below 2^extendedRangeExponent, matches EXTENDED_RANGE_EXPONENT in the kernels
+const double glitchTolerance = 1e-6; //a perturbed pixel is glitched once |z|^2 < glitchTolerance |Z|^2, matches GLITCH_TOLERANCE in the kernels
+
+struct cpuKernelArgs {
+    gBufferPixel* gBuffer = NULL;
+    int screenWidth = 0;
+    int screenHeight = 0;
+    double zoom = 3;
+    double positionX = 0;
+    double positionY = 0;
+    int maxIterations = 0;
+    bool julia = false;
+    double cX = 0;
+    double cY = 0;
+    pixelState* state = NULL;
+    int stateMode = stateNone;
+    int previousMaxIterations = 0; //maxIterations the stored state was rendered with
+    pixelTile copyRect; //filled by the mirror pass instead of iterated, empty when the view has no usable symmetry
+    int mirrorX = 0; //julia sets copy (x, y) from (mirrorX - x, mirrorY - y), the mandelbrot set from (x, mirrorY - y)
+    int mirrorY = 0;
+    double cycleTolerance = 0; //orbit points this close to the last snapshot count as a cycle
+    std::atomic<int>* interiorCounts = NULL; //[0] pixels finished by the cardioid/bulb test, [1] by cycle detection
+    int* iterationCounts = NULL; //Mariani-Silver mode and zoom steps only: iteration count of every pixel iterated (or reused) so far, -1 for the rest
+    std::atomic<int>* iteratedPixels = NULL; //pixels that actually went through the escape-time loop
+    pixelTile floatRect; //tiles entirely inside this are iterated in float, the rest in double; see fractal::floatRect
+    const double* referenceOrbit = NULL; //perturbation only: Z_0, Z_1, ... as real and imaginary parts
+    int referenceLength = 0;
+    floatExp frameZoom = 0; //perturbation only: the zoom as the host keeps it, brought to units of 2^scaleExponent per pixel
+    floatExp offsetX = 0; //perturbation only: view centre minus the reference point
+    floatExp offsetY = 0;
+    double referenceX = 0; //perturbation only: the reference point rounded to double
+    double referenceY = 0;
+    const blaStep* blaTable = NULL; //perturbation only: steps that skip iterations, see bla table.h
+    int blaLevels = 0; //0 iterates every step
+    std::atomic<long long>* skippedIterations = NULL; //iterations the BLA steps stood in for
+    int scaleExponent = 0; //perturbation only: 0, or the zoom's exponent for views deeper than doubles reach
+    const int* pixelList = NULL; //perturbation only: render just these pixels (y * screenWidth + x) instead of the whole frame
+    int pixelCount = 0;
+    int* glitchList = NULL; //perturbation only: glitched pixels are appended here, NULL skips the glitch test
+    std::atomic<int>* glitchCount = NULL;
+    const std::atomic<int>* latestGeneration = NULL; //the newest view generation the UI thread asked for, NULL for a frame that must finish
+    int generation = 0; //the one this frame renders, tiles are skipped once latestGeneration has moved past it
+
+    bool abandoned() const { return latestGeneration != NULL && latestGeneration->load(std::memory_order_relaxed) != generation; }
+};
+
+struct cpuColourArgs {
+    const gBufferPixel* gBuffer = NULL;
+    uint32_t* pixelArr = NULL;
+    int pixelCount = 0;
+    int colouringScheme = 0;
+    const uint32_t* palette = NULL; //paletteSize entries baked by colourPalette
+    double colourCycle = 0; //palette phase, in palette periods
+    double lightAngle = 45; //in degrees
+    double lightHeight = 1.5;
+};
+
+enum cpuInstructionSet { isaScalar, isaSSE2, isaAVX2, isaAVX512 };
+
+inline const char* instructionSetName(cpuInstructionSet isa) {
+    switch (isa) {
+    case isaSSE2: return "SSE2";
+    case isaAVX2: return "AVX2";
+    case isaAVX512: return "AVX-512";
+    default: return "scalar";
+    }
+}
+
+inline cpuInstructionSet detectInstructionSet() {
+#if CPU_RENDERER_X86
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+    bool avxState = (xcr0 & 0x06) == 0x06;
+    bool avx512State = (xcr0 & 0xE6) == 0xE6;
+    bool avx2 = false;
+    bool avx512f = false;
+    if (maxLeaf >= 7) {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0;
+        avx512f = (info[1] & (1 << 16)) != 0;
+    }
+    if (avx512f && avx512State) { return isaAVX512; }
+    if (avx2 && avxState) { return isaAVX2; }
+    return isaSSE2;
+#else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) { return isaAVX512; }
+    if (__builtin_cpu_supports("avx2")) { return isaAVX2; }
+    return isaSSE2;
+#endif
+#else
+    return isaScalar;
+#endif
+}
+
+// Same pixel -> plane mapping as the kernels.
+inline void pixelToPlane(const cpuKernelArgs& args, int pixelIndex, double& real, double& imag) {
+    int x = pixelIndex % args.screenWidth;
+    int y = pixelIndex / args.screenWidth;
+    double aspectRatio = (double)args.screenWidth / args.screenHeight;
+    real = ((double)x / args.screenWidth - 0.5) * args.zoom * aspectRatio + args.positionX;
+    imag = ((double)y / args.screenHeight - 0.5) * args.zoom + args.positionY;
+}
+
+// Main cardioid and period-2 bulb, where every orbit is bounded.
+inline bool insideMainBulbs(double x, double y) {
+    double q = (x - 0.25) * (x - 0.25) + y * y;
+    if (q * (q + (x - 0.25)) <= 0.25 * y * y) { return true; }
+    return (x + 1) * (x + 1) + y * y <= 0.0625;
+}
+
+// Pixel (x, y) of a Mariani-Silver rectangle whose border all stopped at the same iteration, blended
+// from the rectangle's corners like interpolatePixel in the kernels.
+inline gBufferPixel interpolatePixel(const gBufferPixel* gBuffer, int screenWidth, const pixelTile& rect, int x, int y) {
+    const gBufferPixel& topLeft = gBuffer[rect.y * screenWidth + rect.x];
+    if (topLeft.interior) { return topLeft; }
+    const gBufferPixel& topRight = gBuffer[rect.y * screenWidth + rect.x + rect.width - 1];
+    const gBufferPixel& bottomLeft = gBuffer[(rect.y + rect.height - 1) * screenWidth + rect.x];
+    const gBufferPixel& bottomRight = gBuffer[(rect.y + rect.height - 1) * screenWidth + rect.x + rect.width - 1];
+    float fx = (float)(x - rect.x) / (rect.width - 1);
+    float fy = (float)(y - rect.y) / (rect.height - 1);
+    float w00 = (1 - fx) * (1 - fy);
+    float w10 = fx * (1 - fy);
+    float w01 = (1 - fx) * fy;
+    float w11 = fx * fy;
+
+    gBufferPixel result;
+    result.smoothIteration = w00 * topLeft.smoothIteration + w10 * topRight.smoothIteration + w01 * bottomLeft.smoothIteration + w11 * bottomRight.smoothIteration;
+    result.magnitude = w00 * topLeft.magnitude + w10 * topRight.magnitude + w01 * bottomLeft.magnitude + w11 * bottomRight.magnitude;
+    float normalX = w00 * std::cos(topLeft.normalAngle) + w10 * std::cos(topRight.normalAngle) + w01 * std::cos(bottomLeft.normalAngle) + w11 * std::cos(bottomRight.normalAngle);
+    float normalY = w00 * std::sin(topLeft.normalAngle) + w10 * std::sin(topRight.normalAngle) + w01 * std::sin(bottomLeft.normalAngle) + w11 * std::sin(bottomRight.normalAngle);
+    result.normalAngle = std::atan2(normalY, normalX);
+    result.interior = 0;
+    return result;
+}
+
+// Palette entry of an escaped pixel; one palette period per unit of log(smooth iteration).
+inline int paletteIndex(float smoothIteration, double colourCycle) {
+    float position = std::log(smoothIteration) + (float)colourCycle;
+    position -= std::floor(position);
+    return (std::min)((std::max)((int)(position * paletteSize), 0), paletteSize - 1);
+}
+
+// G-buffer entry of a finished pixel, identical to the tail of the kernels.
+inline gBufferPixel shadePixel(const cpuKernelArgs& args, int iteration, double zReal, double zImag, double derReal, double derImag) {
+    gBufferPixel result = { 0, 0, 0, 1 };
+    if (iteration == args.maxIterations) { return result; }
+    double magnitude = zReal * zReal + zImag * zImag;
+    result.smoothIteration = (float)(iteration + 2 - log(log(magnitude)) / log((double)2));
+    result.magnitude = (float)magnitude;
+    // arg(z/der) = arg(z*conj(der))
+    result.normalAngle = (float)atan2(zImag * derReal - zReal * derImag, zReal * derReal + zImag * derImag);
+    result.interior = 0;
+    return result;
+}
+
+// Same as blaLookup in the kernels: the longest step of args.blaTable that starts at iteration, is valid for d and is no
+// longer than maxLength, 0 if there is none.
+inline int blaLookup(const cpuKernelArgs& args, int iteration, double dReal, double dImag, int maxLength, const blaStep*& found) {
+    int index = iteration - 1;
+    int count = args.referenceLength - 2;
+    double magnitude = dReal * dReal + dImag * dImag;
+    int length = 0;
+    int start = 0;
+    for (int level = 1; level <= args.blaLevels && index >= 0; level++) {
+        int i = index >> level;
+        if ((i << level) != index || i >= count >> level || (1 << level) > maxLength) { break; }
+        const blaStep* step = args.blaTable + start + i;
+        if (magnitude >= step->radius * step->radius) { break; }
+        found = step;
+        length = 1 << level;
+        start += count >> level;
+    }
+    return length;
+}
+
+// Same as blaLookupExtended in the kernels, for d in units of 2^exponent: compares exponents instead of magnitudes.
+inline int blaLookupExtended(const cpuKernelArgs& args, int iteration, double dReal, double dImag, int exponent, int maxLength, const blaStep*& found) {
+    int index = iteration - 1;
+    int count = args.referenceLength - 2;
+    double largest = (std::max)(fabs(dReal), fabs(dImag));
+    int bound = largest == 0 ? INT_MIN + 1 : ilogb(largest) + 2 + exponent;
+    int length = 0;
+    int start = 0;
+    for (int level = 1; level <= args.blaLevels && index >= 0; level++) {
+        int i = index >> level;
+        if ((i << level) != index || i >= count >> level || (1 << level) > maxLength) { break; }
+        const blaStep* step = args.blaTable + start + i;
+        if (bound > step->radiusExponent) { break; }
+        found = step;
+        length = 1 << level;
+        start += count >> level;
+    }
+    return length;
+}
+
+// Same as normalise in the kernels: scales (real, imag) below 1 by a power of two that is added to exponent, returns the shift.
+inline int normaliseScaled(double& real, double& imag, int& exponent) {
+    double largest = (std::max)(fabs(real), fabs(imag));
+    if (largest < 1) { return 0; }
+    int shift = ilogb(largest) + 1;
+    real = ldexp(real, -shift);
+    imag = ldexp(imag, -shift);
+    exponent += shift;
+    return shift;
+}
+
+// Same as isGlitched in the kernels: z = Z + d has nearly cancelled to 0, and d's rounding error swamps it.
+inline bool isGlitched(double zReal, double zImag, const double* reference) {
+    return zReal * zReal + zImag * zImag < glitchTolerance * (reference[0] * reference[0] + reference[1] * reference[1]);
+}
+
+// Same as mandelbrotPerturbationPixel and juliaPerturbationPixel in the kernels: iterates only the pixel's offset d from the
+// reference orbit Z, d = (2 Z + d) d + dc (no dc for julia sets), and carries on with plain z^2 + c past the orbit's end.
+// BLA steps stand in for runs of iterations wherever they are valid, their length is added to skipped.
+// With args.glitchList the pixel stops as soon as isGlitched catches it or it outlives the orbit, and sets glitched.
+inline gBufferPixel perturbationPixel(const cpuKernelArgs& args, int x, int y, long long& skipped, bool& glitched) {
+    double aspectRatio = (double)args.screenWidth / args.screenHeight;
+    double zoom = args.frameZoom.scaled(args.scaleExponent);
+    double offsetReal = ((double)x / args.screenWidth - 0.5) * zoom * aspectRatio + args.offsetX.scaled(args.scaleExponent);
+    double offsetImag = ((double)y / args.screenHeight - 0.5) * zoom + args.offsetY.scaled(args.scaleExponent);
+    const double* orbit = args.referenceOrbit;
+    double dcReal = args.julia ? 0 : offsetReal;
+    double dcImag = args.julia ? 0 : offsetImag;
+    double cReal = args.julia ? args.cX : args.referenceX + offsetReal;
+    double cImag = args.julia ? args.cY : args.referenceY + offsetImag;
+    double dReal = args.julia ? offsetReal : 0;
+    double dImag = args.julia ? offsetImag : 0;
+    double zReal = orbit[0] + dReal;
+    double zImag = orbit[1] + dImag;
+    double derReal = 1;
+    double derImag = 0;
+    double derStep = args.julia ? 0 : 1;
+    int iteration = 0;
+    double temp;
+
+    while (zReal * zReal + zImag * zImag < 8 * 8 && ++iteration < args.maxIterations) {
+        const blaStep* skip = NULL;
+        int length = iteration < args.referenceLength ? blaLookup(args, iteration - 1, dReal, dImag, args.maxIterations - iteration, skip) : 0;
+        if (length > 0) {
+            // d = A d + B dc and der = A der + B, straight to the end of the step
+            temp = skip->aReal * dImag + skip->aImag * dReal + skip->bReal * dcImag + skip->bImag * dcReal;
+            dReal = skip->aReal * dReal - skip->aImag * dImag + skip->bReal * dcReal - skip->bImag * dcImag;
+            dImag = temp;
+            temp = skip->aReal * derImag + skip->aImag * derReal + skip->bImag;
+            derReal = skip->aReal * derReal - skip->aImag * derImag + skip->bReal;
+            derImag = temp;
+            iteration += length - 1;
+            zReal = orbit[2 * iteration] + dReal;
+            zImag = orbit[2 * iteration + 1] + dImag;
+            skipped += length;
+            if (args.glitchList && isGlitched(zReal, zImag, orbit + 2 * iteration)) {
+                glitched = true;
+                break;
+            }
+            continue;
+        }
+
+        temp = (derReal * zImag + derImag * zReal) * 2;
+        derReal = (derReal * zReal - derImag * zImag) * 2 + derStep;
+        derImag = temp;
+
+        if (iteration < args.referenceLength) {
+            const double* reference = orbit + 2 * (iteration - 1);
+            double sumReal = 2 * reference[0] + dReal;
+            double sumImag = 2 * reference[1] + dImag;
+            temp = sumReal * dImag + sumImag * dReal + dcImag;
+            dReal = sumReal * dReal - sumImag * dImag + dcReal;
+            dImag = temp;
+            zReal = reference[2] + dReal;
+            zImag = reference[3] + dImag;
+            if (args.glitchList && isGlitched(zReal, zImag, reference + 2)) {
+                glitched = true;
+                break;
+            }
+        }
+        else {
+            if (args.glitchList) { //the reference escaped first, from here on the pixel is only as precise as a double
+                glitched = true;
+                break;
+            }
+            temp = 2 * zReal * zImag + cImag;
+            zReal = zReal * zReal - zImag * zImag + cReal;
+            zImag = temp;
+        }
+    }
+    return shadePixel(args, iteration, zReal, zImag, derReal, derImag);
+}
+
+// Same as mandelbrotExtendedPixel and juliaExtendedPixel in the kernels: perturbationPixel with d (and dc) kept in units of
+// 2^exponent until d grows past 2^extendedRangeExponent, and der with an exponent of its own.
+inline gBufferPixel perturbationPixelExtended(const cpuKernelArgs& args, int x, int y, long long& skipped, bool& glitched) {
+    double aspectRatio = (double)args.screenWidth / args.screenHeight;
+    double zoom = args.frameZoom.scaled(args.scaleExponent);
+    double offsetReal = ((double)x / args.screenWidth - 0.5) * zoom * aspectRatio + args.offsetX.scaled(args.scaleExponent);
+    double offsetImag = ((double)y / args.screenHeight - 0.5) * zoom + args.offsetY.scaled(args.scaleExponent);
+    const double* orbit = args.referenceOrbit;
+    int exponent = args.scaleExponent;
+    bool scaled = true;
+    double dcReal = args.julia ? 0 : offsetReal;
+    double dcImag = args.julia ? 0 : offsetImag;
+    double dReal = args.julia ? offsetReal : 0;
+    double dImag = args.julia ? offsetImag : 0;
+    if (args.julia) { normaliseScaled(dReal, dImag, exponent); }
+    else { normaliseScaled(dcReal, dcImag, exponent); }
+    double zReal = orbit[0] + ldexp(dReal, exponent);
+    double zImag = orbit[1] + ldexp(dImag, exponent);
+    double derReal = 1;
+    double derImag = 0;
+    int derExponent = 0;
+    double derStep = args.julia ? 0 : 1;
+    int iteration = 0;
+    double temp;
+
+    while (zReal * zReal + zImag * zImag < 8 * 8 && ++iteration < args.maxIterations) {
+        const blaStep* skip = NULL;
+        int length = 0;
+        if (iteration < args.referenceLength) {
+            length = scaled ? blaLookupExtended(args, iteration - 1, dReal, dImag, exponent, args.maxIterations - iteration, skip)
+                : blaLookup(args, iteration - 1, dReal, dImag, args.maxIterations - iteration, skip);
+        }
+        if (length > 0) {
+            temp = skip->aReal * dImag + skip->aImag * dReal + skip->bReal * dcImag + skip->bImag * dcReal;
+            dReal = skip->aReal * dReal - skip->aImag * dImag + skip->bReal * dcReal - skip->bImag * dcImag;
+            dImag = temp;
+            temp = skip->aReal * derImag + skip->aImag * derReal + skip->bImag * derStep;
+            derReal = skip->aReal * derReal - skip->aImag * derImag + skip->bReal * derStep;
+            derImag = temp;
+            iteration += length - 1;
+            skipped += length;
+        }
+        else {
+            temp = (derReal * zImag + derImag * zReal) * 2;
+            derReal = (derReal * zReal - derImag * zImag) * 2 + derStep;
+            derImag = temp;
+
+            if (iteration < args.referenceLength) {
+                const double* reference = orbit + 2 * (iteration - 1);
+                double sumReal = 2 * reference[0] + (scaled ? ldexp(dReal, exponent) : dReal);
+                double sumImag = 2 * reference[1] + (scaled ? ldexp(dImag, exponent) : dImag);
+                temp = sumReal * dImag + sumImag * dReal + dcImag;
+                dReal = sumReal * dReal - sumImag * dImag + dcReal;
+                dImag = temp;
+            }
+            else {
+                if (args.glitchList) { //the reference escaped first, from here on the pixel is only as precise as a double
+                    glitched = true;
+                    break;
+                }
+                double cReal = args.julia ? args.cX : args.referenceX + (scaled ? ldexp(dcReal, exponent) : dcReal);
+                double cImag = args.julia ? args.cY : args.referenceY + (scaled ? ldexp(dcImag, exponent) : dcImag);
+                temp = 2 * zReal * zImag + cImag;
+                zReal = zReal * zReal - zImag * zImag + cReal;
+                zImag = temp;
+            }
+        }
+        if (normaliseScaled(derReal, derImag, derExponent) != 0 && !args.julia) { derStep = ldexp(1.0, -derExponent); }
+        if (iteration >= args.referenceLength) { continue; }
+
+        if (scaled) {
+            int shift = normaliseScaled(dReal, dImag, exponent);
+            dcReal = ldexp(dcReal, -shift);
+            dcImag = ldexp(dcImag, -shift);
+            double largest = (std::max)(fabs(dReal), fabs(dImag));
+            if (largest != 0 && ilogb(largest) + exponent >= extendedRangeExponent) {
+                dReal = ldexp(dReal, exponent);
+                dImag = ldexp(dImag, exponent);
+                dcReal = ldexp(dcReal, exponent);
+                dcImag = ldexp(dcImag, exponent);
+                scaled = false;
+            }
+        }
+        zReal = orbit[2 * iteration] + (scaled ? ldexp(dReal, exponent) : dReal);
+        zImag = orbit[2 * iteration + 1] + (scaled ? ldexp(dImag, exponent) : dImag);
+        if (args.glitchList && isGlitched(zReal, zImag, orbit + 2 * iteration)) {
+            glitched = true;
+            break;
+        }
+    }
+    return shadePixel(args, iteration, zReal, zImag, derReal, derImag);
+}
+
+// Colour pass, identical to colourKernel.
+inline uint32_t colourPixel(const cpuColourArgs& args, const gBufferPixel& pixel) {
+    if (pixel.interior) {
+        return ((uint32_t)(255) << 24); // black
+    }
+    if (args.colouringScheme == 0) {
+        return args.palette[paletteIndex(pixel.smoothIteration, args.colourCycle)];
+    }
+
+    // u.v with u the unit normal and v the light direction
+    double radians = args.lightAngle * (M_PI / 180);
+    double t = cos((double)pixel.normalAngle + radians) + args.lightHeight;
+    t /= 1 + args.lightHeight;
+    if (t < 0) { t = 0; }
+
+    return ((uint32_t)(255) << 24)
+        | ((uint32_t)(t * 255) << 16) // red
+        | ((uint32_t)(t * 255) << 8) // green
+        | ((uint32_t)(t * 255) << 0); // blue
+}
+
+// Portable fallback, also the reference the vector paths are checked against.
+namespace cpuScalar {
+    template <class T>
+    struct scalarLanes {
+        typedef T real;
+        typedef T reg;
+        typedef bool mask;
+        static const int width = 1;
+        static reg set1(double a) { return (T)a; }
+        static reg load(const T* p) { return *p; }
+        static void store(T* p, reg a) { *p = a; }
+        static reg add(reg a, reg b) { return a + b; }
+        static reg sub(reg a, reg b) { return a - b; }
+        static reg mul(reg a, reg b) { return a * b; }
+        static mask less(reg a, reg b) { return a < b; }
+        static mask lessEqual(reg a, reg b) { return a <= b; }
+        static mask notLess(reg a, reg b) { return !(a < b); }
+        static mask equal(reg a, reg b) { return a == b; }
+        static mask maskOr(mask a, mask b) { return a || b; }
+        static mask maskAnd(mask a, mask b) { return a && b; }
+        static int bits(mask a) { return a ? 1 : 0; }
+        static reg select(mask m, reg a, reg b) { return m ? a : b; }
+    };
+    typedef scalarLanes<double> doubleLanes;
+    typedef scalarLanes<float> floatLanes;
+#include "cpu lanes.h"
+}
+
+#if CPU_RENDERER_X86
+
+namespace cpuSSE2 {
+    struct doubleLanes {
+        typedef double real;
+        typedef __m128d reg;
+        typedef __m128d mask;
+        static const int width = 2;
+        static reg set1(double a) { return _mm_set1_pd(a); }
+        static reg load(const double* p) { return _mm_load_pd(p); }
+        static void store(double* p, reg a) { _mm_store_pd(p, a); }
+        static reg add(reg a, reg b) { return _mm_add_pd(a, b); }
+        static reg sub(reg a, reg b) { return _mm_sub_pd(a, b); }
+        static reg mul(reg a, reg b) { return _mm_mul_pd(a, b); }
+        static mask less(reg a, reg b) { return _mm_cmplt_pd(a, b); }
+        static mask lessEqual(reg a, reg b) { return _mm_cmple_pd(a, b); }
+        static mask notLess(reg a, reg b) { return _mm_cmpnlt_pd(a, b); }
+        static mask equal(reg a, reg b) { return _mm_cmpeq_pd(a, b); }
+        static mask maskOr(mask a, mask b) { return _mm_or_pd(a, b); }
+        static mask maskAnd(mask a, mask b) { return _mm_and_pd(a, b); }
+        static int bits(mask a) { return _mm_movemask_pd(a); }
+        static reg select(mask m, reg a, reg b) { return _mm_or_pd(_mm_and_pd(m, a), _mm_andnot_pd(m, b)); }
+    };
+    struct floatLanes {
+        typedef float real;
+        typedef __m128 reg;
+        typedef __m128 mask;
+        static const int width = 4;
+        static reg set1(double a) { return _mm_set1_ps((float)a); }
+        static reg load(const float* p) { return _mm_load_ps(p); }
+        static void store(float* p, reg a) { _mm_store_ps(p, a); }
+        static reg add(reg a, reg b) { return _mm_add_ps(a, b); }
+        static reg sub(reg a, reg b) { return _mm_sub_ps(a, b); }
+        static reg mul(reg a, reg b) { return _mm_mul_ps(a, b); }
+        static mask less(reg a, reg b) { return _mm_cmplt_ps(a, b); }
+        static mask lessEqual(reg a, reg b) { return _mm_cmple_ps(a, b); }
+        static mask notLess(reg a, reg b) { return _mm_cmpnlt_ps(a, b); }
+        static mask equal(reg a, reg b) { return _mm_cmpeq_ps(a, b); }
+        static mask maskOr(mask a, mask b) { return _mm_or_ps(a, b); }
+        static mask maskAnd(mask a, mask b) { return _mm_and_ps(a, b); }
+        static int bits(mask a) { return _mm_movemask_ps(a); }
+        static reg select(mask m, reg a, reg b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+    };
+#include "cpu lanes.h"
+}
+
+// GCC and Clang only emit AVX instructions inside functions compiled for that target, so the
+// AVX2 and AVX-512 paths are wrapped in target regions. MSVC accepts the intrinsics anywhere.
+// Contraction into FMA is kept off so every path rounds exactly like the scalar kernels.
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#pragma GCC optimize("fp-contract=off")
+#endif
+namespace cpuAVX2 {
+    struct doubleLanes {
+        typedef double real;
+        typedef __m256d reg;
+        typedef __m256d mask;
+        static const int width = 4;
+        static reg set1(double a) { return _mm256_set1_pd(a); }
+        static reg load(const double* p) { return _mm256_load_pd(p); }
+        static void store(double* p, reg a) { _mm256_store_pd(p, a); }
+        static reg add(reg a, reg b) { return _mm256_add_pd(a, b); }
+        static reg sub(reg a, reg b) { return _mm256_sub_pd(a, b); }
+        static reg mul(reg a, reg b) { return _mm256_mul_pd(a, b); }
+        static mask less(reg a, reg b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+        static mask lessEqual(reg a, reg b) { return _mm256_cmp_pd(a, b, _CMP_LE_OQ); }
+        static mask notLess(reg a, reg b) { return _mm256_cmp_pd(a, b, _CMP_NLT_UQ); }
+        static mask equal(reg a, reg b) { return _mm256_cmp_pd(a, b, _CMP_EQ_OQ); }
+        static mask maskOr(mask a, mask b) { return _mm256_or_pd(a, b); }
+        static mask maskAnd(mask a, mask b) { return _mm256_and_pd(a, b); }
+        static int bits(mask a) { return _mm256_movemask_pd(a); }
+        static reg select(mask m, reg a, reg b) { return _mm256_blendv_pd(b, a, m); }
+    };
+    struct floatLanes {
+        typedef float real;
+        typedef __m256 reg;
+        typedef __m256 mask;
+        static const int width = 8;
+        static reg set1(double a) { return _mm256_set1_ps((float)a); }
+        static reg load(const float* p) { return _mm256_load_ps(p); }
+        static void store(float* p, reg a) { _mm256_store_ps(p, a); }
+        static reg add(reg a, reg b) { return _mm256_add_ps(a, b); }
+        static reg sub(reg a, reg b) { return _mm256_sub_ps(a, b); }
+        static reg mul(reg a, reg b) { return _mm256_mul_ps(a, b); }
+        static mask less(reg a, reg b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+        static mask lessEqual(reg a, reg b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+        static mask notLess(reg a, reg b) { return _mm256_cmp_ps(a, b, _CMP_NLT_UQ); }
+        static mask equal(reg a, reg b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+        static mask maskOr(mask a, mask b) { return _mm256_or_ps(a, b); }
+        static mask maskAnd(mask a, mask b) { return _mm256_and_ps(a, b); }
+        static int bits(mask a) { return _mm256_movemask_ps(a); }
+        static reg select(mask m, reg a, reg b) { return _mm256_blendv_ps(b, a, m); }
+    };
+#include "cpu lanes.h"
+}
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx512f"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+#pragma GCC optimize("fp-contract=off")
+#endif
+namespace cpuAVX512 {
+    struct doubleLanes {
+        typedef double real;
+        typedef __m512d reg;
+        typedef __mmask8 mask;
+        static const int width = 8;
+        static reg set1(double a) { return _mm512_set1_pd(a); }
+        static reg load(const double* p) { return _mm512_load_pd(p); }
+        static void store(double* p, reg a) { _mm512_store_pd(p, a); }
+        static reg add(reg a, reg b) { return _mm512_add_pd(a, b); }
+        static reg sub(reg a, reg b) { return _mm512_sub_pd(a, b); }
+        static reg mul(reg a, reg b) { return _mm512_mul_pd(a, b); }
+        static mask less(reg a, reg b) { return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ); }
+        static mask lessEqual(reg a, reg b) { return _mm512_cmp_pd_mask(a, b, _CMP_LE_OQ); }
+        static mask notLess(reg a, reg b) { return _mm512_cmp_pd_mask(a, b, _CMP_NLT_UQ); }
+        static mask equal(reg a, reg b) { return _mm512_cmp_pd_mask(a, b, _CMP_EQ_OQ); }
+        static mask maskOr(mask a, mask b) { return (mask)(a | b); }
+        static mask maskAnd(mask a, mask b) { return (mask)(a & b); }
+        static int bits(mask a) { return (int)a; }
+        static reg select(mask m, reg a, reg b) { return _mm512_mask_blend_pd(m, b, a); }
+    };
+    struct floatLanes {
+        typedef float real;
+        typedef __m512 reg;
+        typedef __mmask16 mask;
+        static const int width = 16;
+        static reg set1(double a) { return _mm512_set1_ps((float)a); }
+        static reg load(const float* p) { return _mm512_load_ps(p); }
+        static void store(float* p, reg a) { _mm512_store_ps(p, a); }
+        static reg add(reg a, reg b) { return _mm512_add_ps(a, b); }
+        static reg sub(reg a, reg b) { return _mm512_sub_ps(a, b); }
+        static reg mul(reg a, reg b) { return _mm512_mul_ps(a, b); }
+        static mask less(reg a, reg b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+        static mask lessEqual(reg a, reg b) { return _mm512_cmp_ps_mask(a, b, _CMP_LE_OQ); }
+        static mask notLess(reg a, reg b) { return _mm512_cmp_ps_mask(a, b, _CMP_NLT_UQ); }
+        static mask equal(reg a, reg b) { return _mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ); }
+        static mask maskOr(mask a, mask b) { return (mask)(a | b); }
+        static mask maskAnd(mask a, mask b) { return (mask)(a & b); }
+        static int bits(mask a) { return (int)a; }
+        static reg select(mask m, reg a, reg b) { return _mm512_mask_blend_ps(m, b, a); }
+    };
+#include "cpu lanes.h"
+}
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#endif // CPU_RENDERER_X86
+
+struct cpuRenderer {
+    cpuInstructionSet instructionSet;
+    bool allowFloat = true;
+    int tileSize = 32; //in pixels
+    tileScheduler scheduler;
+
+    explicit cpuRenderer(int threadCount = 0) : instructionSet(detectInstructionSet()), scheduler(threadCount) {}
+
+    // Float lanes iterate tile if it lies entirely inside args.floatRect, where float rounding stays far below a pixel.
+    bool canUseFloat(const cpuKernelArgs& args, const pixelTile& tile) const {
+        return allowFloat && tile.width > 0 && tile.height > 0 && insideTile(args.floatRect, tile.x, tile.y)
+            && insideTile(args.floatRect, tile.x + tile.width - 1, tile.y + tile.height - 1);
+    }
+
+    void renderTile(const cpuKernelArgs& args, const pixelTile& tile, bool useFloat) const {
+        switch (instructionSet) {
+#if CPU_RENDERER_X86
+        case isaAVX512: cpuAVX512::renderTile(args, tile, useFloat); break;
+        case isaAVX2: cpuAVX2::renderTile(args, tile, useFloat); break;
+        case isaSSE2: cpuSSE2::renderTile(args, tile, useFloat); break;
+#endif
+        default: cpuScalar::renderTile(args, tile, useFloat); break;
+        }
+    }
+
+    // Iterates the whole frame described by args into args.gBuffer.
+    void render(const cpuKernelArgs& args) {
+        pixelTile frame;
+        frame.width = args.screenWidth;
+        frame.height = args.screenHeight;
+        render(args, frame);
+    }
+
+    // Iterates only region of the frame, like the kernels' renderRect. Once args is abandoned, the tiles not started yet are
+    // skipped, as the kernels stop claiming them; so are those of renderPerturbation and renderMarianiSilver.
+    void render(const cpuKernelArgs& args, const pixelTile& region) {
+        int tilesX = (region.width + tileSize - 1) / tileSize;
+        int tilesY = (region.height + tileSize - 1) / tileSize;
+        scheduler.run(tilesX * tilesY, [&](int index) {
+            pixelTile tile;
+            tile.x = region.x + (index % tilesX) * tileSize;
+            tile.y = region.y + (index / tilesX) * tileSize;
+            tile.width = (std::min)(tileSize, region.x + region.width - tile.x);
+            tile.height = (std::min)(tileSize, region.y + region.height - tile.y);
+            if (args.abandoned()) { return; }
+            if (insideTile(args.copyRect, tile.x, tile.y) && insideTile(args.copyRect, tile.x + tile.width - 1, tile.y + tile.height - 1)) {
+                return; //left to the mirror pass
+            }
+            renderTile(args, tile, canUseFloat(args, tile));
+        });
+    }
+
+    // Renders the whole frame by perturbation around args.referenceOrbit, or only args.pixelList, same as perturbationKernel.
+    void renderPerturbation(const cpuKernelArgs& args) {
+        int tilesX = (args.screenWidth + tileSize - 1) / tileSize;
+        int tilesY = (args.screenHeight + tileSize - 1) / tileSize;
+        int listTile = tileSize * tileSize; //list entries per unit of work
+        int tiles = args.pixelList ? (args.pixelCount + listTile - 1) / listTile : tilesX * tilesY;
+        scheduler.run(tiles, [&](int index) {
+            if (args.abandoned()) { return; }
+            long long skipped = 0;
+            auto renderPixel = [&](int x, int y) {
+                bool glitched = false;
+                args.gBuffer[y * args.screenWidth + x] = args.scaleExponent != 0 ? perturbationPixelExtended(args, x, y, skipped, glitched) : perturbationPixel(args, x, y, skipped, glitched);
+                if (glitched) { args.glitchList[(*args.glitchCount)++] = y * args.screenWidth + x; }
+            };
+            if (args.pixelList) {
+                for (int i = index * listTile; i < (std::min)((index + 1) * listTile, args.pixelCount); i++) {
+                    renderPixel(args.pixelList[i] % args.screenWidth, args.pixelList[i] / args.screenWidth);
+                }
+            }
+            else {
+                int tileX = (index % tilesX) * tileSize;
+                int tileY = (index / tilesX) * tileSize;
+                for (int y = tileY; y < (std::min)(tileY + tileSize, args.screenHeight); y++) {
+                    for (int x = tileX; x < (std::min)(tileX + tileSize, args.screenWidth); x++) { renderPixel(x, y); }
+                }
+            }
+            if (args.skippedIterations && skipped > 0) { *args.skippedIterations += skipped; }
+        });
+    }
+
+    // Mariani-Silver mode, same result as the passes of marianiSilverKernel: the frame is cut into
+    // marianiSilverBlockSize squares (minus copyRect), and each worker subdivides its square depth
+    // first instead of pass by pass. args.iterationCounts must have a slot per pixel.
+    void renderMarianiSilver(const cpuKernelArgs& args, int guard) {
+        std::fill(args.iterationCounts, args.iterationCounts + args.screenWidth * args.screenHeight, -1);
+        int blocksX = (args.screenWidth + marianiSilverBlockSize - 1) / marianiSilverBlockSize;
+        int blocksY = (args.screenHeight + marianiSilverBlockSize - 1) / marianiSilverBlockSize;
+        scheduler.run(blocksX * blocksY, [&](int index) {
+            if (args.abandoned()) { return; }
+            pixelTile block;
+            block.x = (index % blocksX) * marianiSilverBlockSize;
+            block.y = (index / blocksX) * marianiSilverBlockSize;
+            block.width = (std::min)(marianiSilverBlockSize, args.screenWidth - block.x);
+            block.height = (std::min)(marianiSilverBlockSize, args.screenHeight - block.y);
+            pixelTile pieces[4];
+            int pieceCount = clipTile(block, args.copyRect, pieces);
+            bool useFloat = canUseFloat(args, block); //the whole block, so the fill test compares counts of one precision
+            for (int i = 0; i < pieceCount; i++) { subdivide(args, pieces[i], guard, useFloat); }
+        });
+    }
+
+    // Iterates the border of rect (and guard x guard probes inside it), then fills rect if they all
+    // stopped at the same iteration and splits it into four otherwise.
+    void subdivide(const cpuKernelArgs& args, const pixelTile& rect, int guard, bool useFloat) const {
+        if (rect.width <= marianiSilverSplitSize || rect.height <= marianiSilverSplitSize) {
+            renderTile(args, rect, useFloat);
+            return;
+        }
+
+        pixelTile edges[4];
+        edges[0].x = rect.x; edges[0].y = rect.y; edges[0].width = rect.width; edges[0].height = 1;
+        edges[1].x = rect.x; edges[1].y = rect.y + rect.height - 1; edges[1].width = rect.width; edges[1].height = 1;
+        edges[2].x = rect.x; edges[2].y = rect.y + 1; edges[2].width = 1; edges[2].height = rect.height - 2;
+        edges[3].x = rect.x + rect.width - 1; edges[3].y = rect.y + 1; edges[3].width = 1; edges[3].height = rect.height - 2;
+        for (int e = 0; e < 4; e++) { renderTile(args, edges[e], useFloat); }
+        int count = args.iterationCounts[rect.y * args.screenWidth + rect.x];
+        bool fill = true;
+        for (int e = 0; e < 4 && fill; e++) {
+            for (int y = edges[e].y; y < edges[e].y + edges[e].height; y++) {
+                for (int x = edges[e].x; x < edges[e].x + edges[e].width; x++) {
+                    if (args.iterationCounts[y * args.screenWidth + x] != count) { fill = false; }
+                }
+            }
+        }
+
+        // a filament thinner than a pixel can cross the rectangle between two border pixels, probe the inside too
+        for (int i = 0; i < guard * guard && fill; i++) {
+            pixelTile probe;
+            probe.x = rect.x + (2 * (i % guard) + 1) * rect.width / (2 * guard);
+            probe.y = rect.y + (2 * (i / guard) + 1) * rect.height / (2 * guard);
+            probe.width = probe.height = 1;
+            renderTile(args, probe, useFloat);
+            if (args.iterationCounts[probe.y * args.screenWidth + probe.x] != count) { fill = false; }
+        }
+
+        if (fill) {
+            for (int y = rect.y; y < rect.y + rect.height; y++) {
+                for (int x = rect.x; x < rect.x + rect.width; x++) {
+                    int pixelIndex = y * args.screenWidth + x;
+                    if (args.iterationCounts[pixelIndex] < 0) { args.gBuffer[pixelIndex] = interpolatePixel(args.gBuffer, args.screenWidth, rect, x, y); }
+                }
+            }
+            return;
+        }
+
+        int halfWidth = rect.width / 2;
+        int halfHeight = rect.height / 2;
+        for (int i = 0; i < 4; i++) {
+            pixelTile child;
+            child.x = rect.x + (i % 2) * halfWidth;
+            child.y = rect.y + (i / 2) * halfHeight;
+            child.width = i % 2 ? rect.width - halfWidth : halfWidth;
+            child.height = i / 2 ? rect.height - halfHeight : halfHeight;
+            subdivide(args, child, guard, useFloat);
+        }
+    }
+
+    // Moves the G-buffer in place by (shiftX, shiftY) pixels, same as shiftKernel: pixel (x, y) takes
+    // what was at (x + shiftX, y + shiftY). Rows are walked away from the side they are copied from.
+    void shift(const cpuKernelArgs& args, int shiftX, int shiftY) {
+        int width = args.screenWidth - abs(shiftX);
+        int rows = args.screenHeight - abs(shiftY);
+        for (int i = 0; i < rows; i++) {
+            int y = shiftY > 0 ? i : args.screenHeight - 1 - i;
+            gBufferPixel* row = args.gBuffer + y * args.screenWidth;
+            const gBufferPixel* source = args.gBuffer + (y + shiftY) * args.screenWidth;
+            memmove(row + (std::max)(0, -shiftX), source + (std::max)(0, shiftX), width * sizeof(gBufferPixel));
+        }
+    }
+
+    // Same as reprojectKernel: fills args.gBuffer with the nearest pixels of source, a frame of the same size rendered at
+    // scale times the zoom and offset by (offsetX, offsetY) of its own pixels. With markReused, args.iterationCounts
+    // gets 0 for the pixels that land exactly on one of source's and -1 for the rest, so that render skips the former.
+    void reproject(const cpuKernelArgs& args, const gBufferPixel* source, double scale, double offsetX, double offsetY, bool markReused) {
+        int width = args.screenWidth;
+        int height = args.screenHeight;
+        scheduler.run(height, [&](int y) {
+            double sourceY = (y - 0.5 * height) * scale + 0.5 * height + offsetY;
+            int nearestY = (std::min)((std::max)((int)floor(sourceY + 0.5), 0), height - 1);
+            for (int x = 0; x < width; x++) {
+                double sourceX = (x - 0.5 * width) * scale + 0.5 * width + offsetX;
+                int nearestX = (std::min)((std::max)((int)floor(sourceX + 0.5), 0), width - 1);
+                args.gBuffer[y * width + x] = source[nearestY * width + nearestX];
+                if (markReused) { args.iterationCounts[y * width + x] = sourceX == nearestX && sourceY == nearestY ? 0 : -1; }
+            }
+        });
+    }
+
+    // Fills args.copyRect from the mirrored pixels once render has iterated the rest, same as mirrorKernel.
+    void mirror(const cpuKernelArgs& args) {
+        const pixelTile& rect = args.copyRect;
+        scheduler.run(rect.height, [&](int row) {
+            int y = rect.y + row;
+            for (int x = rect.x; x < rect.x + rect.width; x++) {
+                gBufferPixel pixel = args.gBuffer[(args.mirrorY - y) * args.screenWidth + (args.julia ? args.mirrorX - x : x)];
+                if (args.julia) { // -z, same derivative
+                    pixel.normalAngle = pixel.normalAngle > 0 ? pixel.normalAngle - (float)M_PI : pixel.normalAngle + (float)M_PI;
+                }
+                else { // conj(z), conj(der)
+                    pixel.normalAngle = -pixel.normalAngle;
+                }
+                args.gBuffer[y * args.screenWidth + x] = pixel;
+            }
+        });
+    }
+
+    // Turns a G-buffer into pixels, a few thousand at a time per worker.
+    void colour(const cpuColourArgs& args) {
+        const int chunkSize = 16384;
+        int chunks = (args.pixelCount + chunkSize - 1) / chunkSize;
+        scheduler.run(chunks, [&](int index) {
+            int end = (std::min)(args.pixelCount, (index + 1) * chunkSize);
+            for (int i = index * chunkSize; i < end; i++) {
+                args.pixelArr[i] = colourPixel(args, args.gBuffer[i]);
+            }
+        });
+    }
+};
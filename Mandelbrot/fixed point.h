@@ -0,0 +1,220 @@
+#pragma once
+
+// Signed fixed-point numbers for view positions and reference orbits deeper than a double can resolve.
+// limb[0] is the integer part and limb[i] the i-th 32 bits after the binary point, most significant
+// first; limbs says how many are in use, which is the precision. Results take the higher precision of
+// their operands, so adding a small double to a position extends it by as many limbs as that needs.
+
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include "float exp.h"
+
+const int fixedPointMaxLimbs = 128; //integer limb plus 127 * 32 fractional bits, pixel spacings down to about 1e-1200
+
+struct fixedPoint {
+    int limbs = 1;
+    bool negative = false;
+    uint32_t limb[fixedPointMaxLimbs] = {};
+
+    fixedPoint() {}
+
+    // exact, as long as value fits the limbs
+    fixedPoint(double value) : fixedPoint(floatExp(value)) {}
+
+    fixedPoint(const floatExp& value) {
+        negative = value.mantissa < 0;
+        // start at the limb the leading bits fall into, the ones before it are 0
+        int first = (std::max)(0, -value.exponent / 32);
+        if (first >= fixedPointMaxLimbs) { return; }
+        double magnitude = ldexp(fabs(value.mantissa), value.exponent + 32 * first);
+        double integer = floor(magnitude);
+        limb[first] = (uint32_t)integer;
+        limbs = first + 1;
+        double fraction = magnitude - integer;
+        while (fraction != 0 && limbs < fixedPointMaxLimbs) {
+            fraction *= 4294967296.0;
+            double digit = floor(fraction);
+            limb[limbs++] = (uint32_t)digit;
+            fraction -= digit;
+        }
+        if (isZero()) { negative = false; }
+    }
+
+    explicit operator floatExp() const {
+        double result = 0;
+        int first = 0;
+        while (first < limbs && limb[first] == 0) { first++; }
+        // a double only holds the first two or three nonzero limbs
+        for (int i = (std::min)(limbs, first + 3) - 1; i >= first; i--) { result += ldexp((double)limb[i], -32 * (i - first)); }
+        return floatExp(negative ? -result : result, -32 * first);
+    }
+
+    explicit operator double() const { return (double)(floatExp)*this; }
+
+    bool isZero() const {
+        for (int i = 0; i < limbs; i++) {
+            if (limb[i] != 0) { return false; }
+        }
+        return true;
+    }
+
+    // Truncates or zero-extends to newLimbs.
+    void setPrecision(int newLimbs) {
+        newLimbs = (std::min)((std::max)(newLimbs, 1), fixedPointMaxLimbs);
+        for (int i = limbs; i < newLimbs; i++) { limb[i] = 0; }
+        limbs = newLimbs;
+        if (isZero()) { negative = false; }
+    }
+
+    // Limbs needed to address pixels pixelSize apart with 64 bits to spare for the rounding of a long orbit.
+    static int limbsFor(const floatExp& pixelSize) {
+        int fractionBits = (int)ceil(-pixelSize.log2()) + 64;
+        return (std::min)((std::max)(1 + (fractionBits + 31) / 32, 2), fixedPointMaxLimbs);
+    }
+
+    static int compareMagnitude(const fixedPoint& a, const fixedPoint& b, int limbs) {
+        for (int i = 0; i < limbs; i++) {
+            uint32_t x = i < a.limbs ? a.limb[i] : 0;
+            uint32_t y = i < b.limbs ? b.limb[i] : 0;
+            if (x != y) { return x < y ? -1 : 1; }
+        }
+        return 0;
+    }
+
+    // result = a + b with b's sign flipped if subtract is set; result may alias a or b
+    static void add(const fixedPoint& a, const fixedPoint& b, bool subtract, fixedPoint& result) {
+        int limbs = (std::max)(a.limbs, b.limbs);
+        bool bNegative = b.negative != subtract;
+        if (a.negative == bNegative) {
+            uint64_t carry = 0;
+            for (int i = limbs - 1; i >= 0; i--) {
+                uint64_t sum = (uint64_t)(i < a.limbs ? a.limb[i] : 0) + (i < b.limbs ? b.limb[i] : 0) + carry;
+                result.limb[i] = (uint32_t)sum;
+                carry = sum >> 32;
+            }
+            result.negative = a.negative;
+        }
+        else {
+            // subtract the smaller magnitude from the larger one
+            bool aLarger = compareMagnitude(a, b, limbs) >= 0;
+            const fixedPoint& larger = aLarger ? a : b;
+            const fixedPoint& smaller = aLarger ? b : a;
+            bool resultNegative = aLarger ? a.negative : bNegative;
+            int64_t borrow = 0;
+            for (int i = limbs - 1; i >= 0; i--) {
+                int64_t difference = (int64_t)(i < larger.limbs ? larger.limb[i] : 0) - (i < smaller.limbs ? smaller.limb[i] : 0) - borrow;
+                borrow = difference < 0;
+                result.limb[i] = (uint32_t)(difference + (borrow << 32));
+            }
+            result.negative = resultNegative;
+        }
+        result.limbs = limbs;
+        if (result.isZero()) { result.negative = false; }
+    }
+
+    // result = a * b, truncated to the higher precision of the two; result must not alias a or b. Only the columns that
+    // survive the truncation are summed, about half the limb products of the whole product.
+    static void multiply(const fixedPoint& a, const fixedPoint& b, fixedPoint& result) {
+        int limbs = (std::max)(a.limbs, b.limbs);
+        // column k has weight 2^(-32k); columns past limbs only feed carries into the last one, so one guard column is kept
+        uint32_t columns[fixedPointMaxLimbs + 1];
+        std::fill(columns, columns + limbs + 1, 0);
+        for (int i = (std::min)(a.limbs, limbs) - 1; i >= 0; i--) {
+            if (a.limb[i] == 0) { continue; }
+            uint64_t carry = 0;
+            for (int j = (std::min)(b.limbs - 1, limbs - i); j >= 0; j--) {
+                uint64_t product = (uint64_t)a.limb[i] * b.limb[j] + columns[i + j] + carry;
+                columns[i + j] = (uint32_t)product;
+                carry = product >> 32;
+            }
+            // overflow past the integer limb is dropped, orbits stay far below 2^32
+            for (int k = i - 1; k >= 0 && carry != 0; k--) {
+                uint64_t sum = (uint64_t)columns[k] + carry;
+                columns[k] = (uint32_t)sum;
+                carry = sum >> 32;
+            }
+        }
+        for (int i = 0; i < limbs; i++) { result.limb[i] = columns[i]; }
+        result.limbs = limbs;
+        result.negative = a.negative != b.negative;
+        if (result.isZero()) { result.negative = false; }
+    }
+
+    // result = a * a, truncated to a's precision like multiply; result may alias a. Every cross product a_i a_j is taken
+    // once and doubled, so squaring costs about half a multiply.
+    static void square(const fixedPoint& a, fixedPoint& result) {
+        int limbs = a.limbs;
+        uint32_t columns[fixedPointMaxLimbs + 1]; //same columns and guard column as multiply
+        std::fill(columns, columns + limbs + 1, 0);
+        for (int i = (limbs - 1) / 2; i >= 0; i--) {
+            if (a.limb[i] == 0) { continue; }
+            uint64_t carry = 0;
+            for (int j = (std::min)(limbs - 1, limbs - i); j > i; j--) {
+                uint64_t product = (uint64_t)a.limb[i] * a.limb[j] + columns[i + j] + carry;
+                columns[i + j] = (uint32_t)product;
+                carry = product >> 32;
+            }
+            for (int k = 2 * i; k >= 0 && carry != 0; k--) {
+                uint64_t sum = (uint64_t)columns[k] + carry;
+                columns[k] = (uint32_t)sum;
+                carry = sum >> 32;
+            }
+        }
+        // double the cross products and add the squares a_m^2, whose low half falls in column 2m and high half in 2m - 1
+        uint64_t carry = 0;
+        for (int k = limbs; k >= 0; k--) {
+            uint64_t sum = ((uint64_t)columns[k] << 1) + carry;
+            int m = (k + 1) / 2;
+            if (m < limbs) {
+                uint64_t diagonal = (uint64_t)a.limb[m] * a.limb[m];
+                sum += k % 2 == 0 ? (uint32_t)diagonal : diagonal >> 32;
+            }
+            columns[k] = (uint32_t)sum;
+            carry = sum >> 32;
+        }
+        for (int i = 0; i < limbs; i++) { result.limb[i] = columns[i]; }
+        result.limbs = limbs;
+        result.negative = false;
+    }
+
+    fixedPoint operator-() const {
+        fixedPoint result = *this;
+        if (!result.isZero()) { result.negative = !negative; }
+        return result;
+    }
+
+    fixedPoint& operator+=(const fixedPoint& other) {
+        add(*this, other, false, *this);
+        return *this;
+    }
+
+    fixedPoint& operator-=(const fixedPoint& other) {
+        add(*this, other, true, *this);
+        return *this;
+    }
+
+    bool operator==(const fixedPoint& other) const {
+        return negative == other.negative && compareMagnitude(*this, other, (std::max)(limbs, other.limbs)) == 0;
+    }
+
+    bool operator!=(const fixedPoint& other) const { return !(*this == other); }
+};
+
+inline fixedPoint operator+(const fixedPoint& a, const fixedPoint& b) {
+    fixedPoint result;
+    fixedPoint::add(a, b, false, result);
+    return result;
+}
+
+inline fixedPoint operator-(const fixedPoint& a, const fixedPoint& b) {
+    fixedPoint result;
+    fixedPoint::add(a, b, true, result);
+    return result;
+}
+
+inline fixedPoint operator*(const fixedPoint& a, const fixedPoint& b) {
+    fixedPoint result;
+    fixedPoint::multiply(a, b, result);
+    return result;
+}
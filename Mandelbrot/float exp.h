@@ -0,0 +1,76 @@
+#pragma once
+
+// Double mantissa with a separate int exponent, for the zoom and for offsets deeper than a double's exponent reaches
+// (about 1e-308). The value is mantissa * 2^exponent, with mantissa 0 or 0.5 <= |mantissa| < 1 as frexp returns it.
+// The kernels declare the same struct and the CPU renderer uses this one: the perturbation frame's zoom and offsets reach
+// both as floatExp, and each brings them to units of 2^scaleExponent itself (floatExpScaled in the kernels, scaled here).
+
+#include <cmath>
+
+// same layout as floatExp in the kernels, it is passed to them as a kernel argument
+struct floatExp {
+    double mantissa = 0;
+    int exponent = 0;
+
+    floatExp() {}
+
+    floatExp(double value) { mantissa = frexp(value, &exponent); }
+
+    // mantissa * 2^exponent, normalised
+    floatExp(double newMantissa, int newExponent) {
+        int shift;
+        mantissa = frexp(newMantissa, &shift);
+        exponent = mantissa == 0 ? 0 : newExponent + shift;
+    }
+
+    // 0 below the smallest double, infinite above the largest
+    explicit operator double() const { return ldexp(mantissa, exponent); }
+
+    // the value in units of 2^unitExponent
+    double scaled(int unitExponent) const { return ldexp(mantissa, exponent - unitExponent); }
+
+    double log2() const { return std::log2(fabs(mantissa)) + exponent; }
+
+    floatExp operator-() const { return floatExp(-mantissa, exponent); }
+
+    floatExp& operator*=(const floatExp& other) { return *this = floatExp(mantissa * other.mantissa, exponent + other.exponent); }
+    floatExp& operator/=(const floatExp& other) { return *this = floatExp(mantissa / other.mantissa, exponent - other.exponent); }
+
+    floatExp& operator+=(const floatExp& other) {
+        if (other.mantissa == 0) { return *this; }
+        if (mantissa == 0) { return *this = other; }
+        // the smaller operand is shifted down to the larger one's exponent, and vanishes if it is 64 or more binary places below
+        if (exponent >= other.exponent) { return *this = floatExp(mantissa + ldexp(other.mantissa, other.exponent - exponent), exponent); }
+        return *this = floatExp(ldexp(mantissa, exponent - other.exponent) + other.mantissa, other.exponent);
+    }
+
+    floatExp& operator-=(const floatExp& other) { return *this += -other; }
+
+    // compares signs, then exponents, then mantissas; normalisation makes that an exact order
+    static int compare(const floatExp& a, const floatExp& b) {
+        int signA = (a.mantissa > 0) - (a.mantissa < 0);
+        int signB = (b.mantissa > 0) - (b.mantissa < 0);
+        if (signA != signB) { return signA < signB ? -1 : 1; }
+        if (signA == 0) { return 0; }
+        if (a.exponent != b.exponent) { return (a.exponent < b.exponent) == (signA > 0) ? -1 : 1; }
+        return a.mantissa < b.mantissa ? -1 : a.mantissa > b.mantissa ? 1 : 0;
+    }
+};
+
+static_assert(sizeof(floatExp) == 16, "floatExp must match the kernels' struct");
+
+inline floatExp operator*(floatExp a, const floatExp& b) { return a *= b; }
+inline floatExp operator/(floatExp a, const floatExp& b) { return a /= b; }
+inline floatExp operator+(floatExp a, const floatExp& b) { return a += b; }
+inline floatExp operator-(floatExp a, const floatExp& b) { return a -= b; }
+inline bool operator<(const floatExp& a, const floatExp& b) { return floatExp::compare(a, b) < 0; }
+inline bool operator>(const floatExp& a, const floatExp& b) { return floatExp::compare(a, b) > 0; }
+inline bool operator<=(const floatExp& a, const floatExp& b) { return floatExp::compare(a, b) <= 0; }
+inline bool operator>=(const floatExp& a, const floatExp& b) { return floatExp::compare(a, b) >= 0; }
+inline bool operator==(const floatExp& a, const floatExp& b) { return floatExp::compare(a, b) == 0; }
+inline bool operator!=(const floatExp& a, const floatExp& b) { return floatExp::compare(a, b) != 0; }
+inline floatExp fabs(const floatExp& value) { return floatExp(fabs(value.mantissa), value.exponent); }
+inline floatExp hypot(const floatExp& x, const floatExp& y) {
+    int unit = x.exponent > y.exponent ? x.exponent : y.exponent;
+    return floatExp(hypot(x.scaled(unit), y.scaled(unit)), unit);
+}
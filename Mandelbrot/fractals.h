@@ -5,144 +5,337 @@
 #include <cmath>
 #include <cstdlib>
 #include <limits>
+#include <climits>
 #include <tuple>
 #include <memory>
+#include <new>
 #include <cstring>
+#include "cpu renderer.h"
+#include "reference orbit.h"
+#include "bla table.h"
+#include "mailbox.h"
 
 using namespace std;
 
 cl_int err;
 
+#ifdef _WIN32
 #define DBOUT( s )            \
 {                             \
    std::wostringstream os_;    \
    os_ << s;                   \
    OutputDebugStringW( os_.str().c_str() );  \
 }
+#else
+#define DBOUT( s )            \
+{                             \
+   std::wcerr << s;            \
+}
+#endif
 
-struct fractal {
-private:
-    Uint32 rmask, gmask, bmask, amask;
-public:
+// cl_khr_priority_hints, missing from the bundled headers
+#ifndef CL_QUEUE_PRIORITY_KHR
+#define CL_QUEUE_PRIORITY_KHR 0x1096
+#define CL_QUEUE_PRIORITY_HIGH_KHR (1 << 0)
+#define CL_QUEUE_PRIORITY_MED_KHR (1 << 1)
+#define CL_QUEUE_PRIORITY_LOW_KHR (1 << 2)
+#endif
+
+// Whether device has fine-grained SVM buffers with atomics, where a value the host stores reaches kernels already running.
+inline bool hasSvmAtomics(cl_device_id device) {
+    cl_device_svm_capabilities capabilities = 0;
+    if (clGetDeviceInfo(device, CL_DEVICE_SVM_CAPABILITIES, sizeof(capabilities), &capabilities, NULL) != CL_SUCCESS) { return false; } //before OpenCL 2.0
+    return (capabilities & CL_DEVICE_SVM_FINE_GRAIN_BUFFER) && (capabilities & CL_DEVICE_SVM_ATOMICS);
+}
+
+const Uint32 pixelFormat = SDL_PIXELFORMAT_ARGB8888; //the frames' format, the one SDL's renderers take without converting
+
+// what the compute kernels iterate in, from the cheapest that resolves the view
+// tierMixed: float where it resolves the pixels, double elsewhere; tierEscalated: double, then perturbation for the tiles it doesn't resolve
+enum precisionTier { tierFloat, tierMixed, tierDouble, tierEscalated, tierPerturbation, tierExtended };
+
+inline const char* precisionName(int tier) {
+    switch (tier) {
+    case tierFloat: return "float";
+    case tierMixed: return "float and double";
+    case tierDouble: return "double";
+    case tierEscalated: return "double and perturbation";
+    case tierPerturbation: return "perturbation";
+    default: return "perturbation, scaled";
+    }
+}
+
+// What the user steers: the UI thread keeps one per fractal for handleInput and sends copies to the render thread,
+// whose fractal takes them with takeView.
+struct fractalView {
     int maxIterations = 1024;
     int maxIterationsFloor = 10;
-    long double position[2] = { 0,0 }; //view centre in the plane
-    double zoom = 3;
+    fixedPoint position[2]; //view centre in the plane, exact to as many bits as the moves that brought it there
+    floatExp zoom = 3; //height of the view in the plane, past what a double's exponent reaches
     long double moveSpeed = 0.15;
     long double zoomSpeed = 0.4;
     int colouringScheme = 0;
-
+    double colourCycle = 0; //palette phase, in palette periods
+    double lightAngle = 45; //in degrees
+    double lightHeight = 1.5;
+    bool marianiSilver = false; //iterate rectangle borders and fill in the rectangles whose border stopped at one iteration count
+    array<double, 2> index = { 0, 0 }; //julia sets' c
     string type = "fractal";
-    SDL_Surface* surface = NULL;
-    SDL_Texture* texture = NULL;
-    uint32_t* writePixelArr;
-    uint32_t* readPixelArr;
-    int width;
-    int height;
-    SDL_Rect rect;
-    cl_queue_properties queueProperties = 0;
-    cl_command_queue queue;
-    cl_mem d_readPixelArr;
-    cl_mem d_writePixelArr;
-    size_t globalWorkSize = 6400;
-    size_t localWorkSize = NULL;
-    int* workQueue;
-    cl_mem d_workQueue;
-    int globalIndex = 0;
-    cl_mem d_globalIndex;
-    int framesToUpdate = 0;
-    cl_mem d_points;
-
-    fractal(int newWidth, int newHeight, SDL_Renderer* renderer, SDL_Window* window, cl_context context, cl_device_id device)
-        : width(newWidth), height(newHeight) {
-
-        writePixelArr = new uint32_t[width * height];
-        readPixelArr = new uint32_t[width * height];
-        workQueue = new int[width * height];
-
-#if SDL_BYTEORDER == SDL_BIG_ENDIAN
-        rmask = 0xff000000;
-        gmask = 0x00ff0000;
-        bmask = 0x0000ff000;
-        amask = 0x000000ff;
-#else // SDL_BYTEORDER == SDL_LIL_ENDIAN
-        rmask = 0x000000ff;
-        gmask = 0x0000ff00;
-        bmask = 0x00ff0000;
-        amask = 0xff000000;
-#endif
+    int width = 0;
+    int height = 0;
+    int framesToUpdate = 0; //frames to render
+    int framesToColour = 0; //frames to rerun only the colour pass for
+    int generation = 0; //bumped by the UI thread for every render it asks for, which is how the render thread tells a new
+    // request from one it has already started on, even when the snapshots in between were dropped
+    int colourGeneration = 0; //same for the colour pass
+};
 
-        surface = SDL_CreateRGBSurface(0, width, height, 32, rmask, gmask, bmask, amask);
-        if (surface == NULL)
-        {
-            printf("Surface could not be created! SDL_Error: %s\n", SDL_GetError());
+// A frame the render thread finished, on its way to the UI thread's texture.
+struct finishedFrame {
+    std::vector<uint32_t> pixelArr; //CPU renderer: width * height, in pixelFormat
+    const uint32_t* pixels = NULL; //what show reads: pixelArr, or on the GPU path a frame slot's mapping, with no copy in between
+    std::atomic<bool> shown{ false }; //set by the UI thread once show is done with pixels, the mapping is kept until then
+    int width = 0;
+    int height = 0;
+    int tier = tierDouble; //precision it was iterated in, for the HUD
+};
 
-            SDL_FreeSurface(surface);
-            SDL_DestroyRenderer(renderer);
-            SDL_DestroyWindow(window);
-            SDL_Quit();
-        }
-        texture = SDL_CreateTextureFromSurface(renderer, surface);
-        if (texture == NULL)
-        {
-            printf("Texture could not be created! SDL_Error: %s\n", SDL_GetError());
+// One frame of the GPU path's ring, from the colour kernel through the frame mailbox to the UI thread's texture.
+struct frameSlot {
+    cl_mem d_pixelArr = NULL; //what the colour kernel wrote, in host memory
+    cl_event mapped = NULL; //completes once d_pixelArr is mapped, NULL while the slot is free
+    uint32_t* pixelArr = NULL; //the mapping
+    int tag = INT_MAX; //frameTag of the frame in it
+    finishedFrame* published = NULL; //the frame handing the mapping to the UI thread, the slot stays mapped until it was shown or dropped
+};
 
-            SDL_DestroyTexture(texture);
-            SDL_FreeSurface(surface);
-            SDL_DestroyRenderer(renderer);
-            SDL_DestroyWindow(window);
-            SDL_Quit();
-        }
+struct fractal : fractalView {
+public:
+    mailbox<finishedFrame> frames; //to the UI thread, the next one is coloured into frames.back()
+    bool activeView = false; //the view the user is working in, set with setActive
+    cl_command_queue queue = NULL;
+    int frameRingDepth = 2; //frames the GPU path keeps in flight before the host waits for the oldest
+    std::atomic<bool> showing{ true }; //cleared by the UI thread once it stops taking frames, nothing waits for them to be shown then
+    std::vector<frameSlot> frameRing;
+    int nextFrame = 0; //slot the next frame is coloured into
+    int framesInFlight = 0; //submitted frames not yet published, the oldest frameRing[nextFrame - framesInFlight]
+    std::atomic<int> latestGeneration{ 0 }; //stored by the UI thread as soon as it asks for a render, so that work on an older view stops before the new one arrives
+    int frameTag = INT_MAX; //set by tagFrame: the generation the frame renders, INT_MAX if it must finish whatever the view does
+    int cancelledBelow = 0; //frames tagged below this stop claiming work, the last value cancelStaleFrames wrote to d_cancelGeneration
+    bool lastFrameAbandoned = false; //so the next one always finishes, and a view that keeps changing still shows frames
+    cl_command_queue cancelQueue = NULL; //writes d_cancelGeneration while queue is still busy with the frames it cancels
+    size_t globalWorkSize = 6400;
+    size_t localWorkSize = 64; //one work group per 8x8 tile, see TILE_SIZE in the kernels
+    int tileClaiming = 1; //1: work groups claim 8x8 tiles in Z-order, 0: work items claim single pixels
+    cl_mem d_globalIndex = NULL; //[0] next pixel to claim, reset on the device before every dispatch; [1] frameTag. Only queue writes it
+    cl_mem d_cancelGeneration = NULL; //cancelledBelow, written by cancelStaleFrames alone
+    std::atomic<int>* cancelGenerationArr = NULL; //the fine-grained SVM under d_cancelGeneration where the device has SVM atomics, NULL otherwise
+    cl_mem d_points = NULL;
+    cpuKernelArgs cpuArgs; //kernel arguments for the CPU renderer, filled by setKernelArgs
+    bool continueIterations = true; //keep per-pixel iteration state so raising maxIterations resumes instead of restarting
+    cl_mem d_pixelState = NULL;
+    pixelState* pixelStateArr = NULL; //CPU renderer's copy of d_pixelState
+    int stateMode = stateNone;
+    int stateIterations = 0; //maxIterations the stored state was rendered with, 0 if there is none
+    int previousMaxIterations = 0;
+    double stateView[5] = {}; //zoom, position and julia index the stored state belongs to
+    cl_mem d_gBuffer = NULL; //per-pixel iteration results, turned into colours by the colour kernel
+    gBufferPixel* gBufferArr = NULL; //CPU renderer's copy of d_gBuffer
+    cpuColourArgs cpuColour; //colour pass arguments for the CPU renderer, filled by setColourKernelArgs
+    double cycleTolerance = 1e-3; //in pixels, orbit points this close to the last snapshot count as a cycle
+    cl_mem d_interiorCounts = NULL; //pixels finished early by the cardioid/bulb test and by cycle detection
+    std::atomic<int> cpuInteriorCounts[2]; //same for the CPU renderer
+    int interiorCounts[2] = { 0, 0 }; //last frame's counts, filled by readInteriorCounts
+    bool useSymmetry = true; //iterate only one side of a symmetric view and mirror the rest
+    cl_mem d_palette = NULL; //baked palette used by the colour kernel
+    int paletteVersion = -1; //colourPalette::version last uploaded to d_palette
+    int marianiSilverGuard = 1; //probes per side inside a uniform rectangle that must match its border too, 0 trusts the border
+    cl_mem d_iterationCounts = NULL; //iteration count of every pixel the Mariani-Silver passes iterated, -1 for the rest
+    int* iterationCountArr = NULL; //CPU renderer's copy of d_iterationCounts
+    cl_mem d_rectLists[2] = { NULL, NULL }; //rectangles left to subdivide, each pass reads one list and writes the other
+    cl_mem d_rectCounts = NULL; //lengths of the two lists
+    cl_mem d_iteratedPixels = NULL; //pixels that actually went through the escape-time loop
+    std::atomic<int> cpuIteratedPixels; //same for the CPU renderer
+    int iteratedPixels = 0; //last frame's count, filled by readIteratedPixels
+    bool incrementalPan = true; //when the view only moved by whole pixels, shift the last G-buffer and iterate just the exposed strips
+    bool panning = false; //set by updatePan: the next dispatch shifts the G-buffer by panShift instead of rendering every pixel
+    int panShift[2] = { 0, 0 }; //whole pixels the view moved since the G-buffer was rendered
+    double panView[7] = {}; //zoom, maxIterations, julia index, size and mode the G-buffer was rendered with
+    double renderedPosition[2] = { 0, 0 }; //position the G-buffer was rendered at, lags position by the sub-pixel remainder of a pan
+    cl_mem d_previousGBuffer = NULL; //the G-buffer shiftKernel copies from
+    int renderRectArg = 0; //index of renderRect in the compute kernel's arguments, iterationCounts, floatRect and tileList follow it
+    bool zoomPreview = true; //while only the zoom changes, show the last full render rescaled instead of iterating every frame
+    bool previewing = false; //set by updatePreview: the next dispatch rescales the preview source into the G-buffer
+    int zoomStep = 0; //set by updatePreview: 1 or -1 to first replace the preview source with a render at twice or half its zoom
+    double previewZoom = 0; //zoom of the preview source kept in d_previousGBuffer, 0 if there is none
+    double previewPosition[2] = { 0, 0 }; //position the preview source was rendered at
+    double previewScale = 1; //new zoom over previewZoom
+    double previewOffset[2] = { 0, 0 }; //position minus previewPosition, in the preview source's pixels
+    double previousZoom = 0; //zoom at the last setKernelArgs
+    double previewView[8] = {}; //position, maxIterations, julia index, size and mode at the last setKernelArgs
+    gBufferPixel* previousGBufferArr = NULL; //CPU renderer's copy of d_previousGBuffer
+    bool allowFloat = true; //iterate in float while it resolves the view, which runs at many times double's rate on most GPUs
+    double floatLimit = 1.0 / 65536; //float iterates the pixels whose coordinates are at most the pixel spacing over this, so its rounding stays far below a pixel
+    int tier = tierDouble; //set by updatePerturbation, what the last frame iterated in
+    bool perturbation = false; //set by updatePerturbation: the view is too deep for double pixel coordinates, render around a reference orbit
+    double perturbationLimit = ldexp(1.0, -36); //perturbation takes over once the pixel spacing drops below this fraction of the largest coordinate on screen, below it double iteration counts drift
+    bool escalating = false; //set by updatePerturbation: tier is tierEscalated, the double render's unresolved tiles go to perturbation
+    cl_mem d_escalatedTiles = NULL; //tiles detectCollapseKernel flagged for the next tier, [0] the count; room for every tile
+    referenceOrbit reference;
+    cl_mem d_referenceOrbit = NULL;
+    size_t referenceCapacity = 0; //bytes d_referenceOrbit has room for
+    bool referenceOnDevice = false; //d_referenceOrbit holds reference.points
+    bool useBla = true; //let perturbed pixels skip runs of iterations with the BLA table
+    double blaEpsilon = ldexp(1.0, -40); //how large the dropped d^2 terms of a BLA step may get, relative to the kept ones; looser than this shows in chaotic regions
+    blaTable bla;
+    cl_mem d_blaTable = NULL;
+    size_t blaCapacity = 0; //bytes d_blaTable has room for
+    bool blaOnDevice = false; //d_blaTable holds bla.steps
+    cl_mem d_skippedIterations = NULL; //iterations the BLA steps stood in for, a 64-bit count as two uints, low word first
+    std::atomic<long long> cpuSkippedIterations; //same for the CPU renderer
+    long long skippedIterations = 0; //last frame's count, filled by readSkippedIterations
+    bool fixGlitches = true; //re-render glitched perturbation pixels around extra reference points placed inside them
+    int maxReferences = 16; //reference orbits per frame, the main one included; pixels still glitched after that stay as they are
+    std::vector<referenceOrbit> glitchReferences; //extra references in the order the last frame placed them, kept while they land on the same pixel
+    std::vector<blaTable> glitchTables; //and their BLA tables
+    cl_mem d_glitchOrbit = NULL; //the extra reference being rendered around
+    size_t glitchOrbitCapacity = 0;
+    cl_mem d_glitchTable = NULL;
+    size_t glitchTableCapacity = 0;
+    cl_mem d_pixelList = NULL; //pixels of the glitch being re-rendered
+    size_t pixelListCapacity = 0;
+    cl_mem d_glitchList = NULL; //pixels the last pass flagged as glitched, room for every pixel
+    cl_mem d_glitchCount = NULL;
+    int* glitchArr = NULL; //host copy of d_glitchList, the CPU renderer appends to it directly
+    std::atomic<int> cpuGlitchCount;
+    int referenceCount = 0; //last frame's reference orbits, the main one included
+    int reRenderedPixels = 0; //last frame's pixels rendered again around extra references
+    bool fixingGlitches = false; //the last perturbation frame's glitch fix-up is under way, it is coloured once fixGlitchedPixels finishes
+    std::vector<int> glitchLeftOver; //glitched pixels of the fix-up there was no reference left for
+    std::vector<std::vector<int>> glitchClusterLists; //the last fix-up pass's clusters, its d_pixelList uploads read from them
+    int glitchReadCount = 0; //GPU path: the last pass's glitch count, read without blocking
+    cl_event glitchCountRead = NULL; //set while glitchReadCount is on its way
+    cl_event glitchListRead = NULL; //set while the first glitchReadCount entries of d_glitchList are on their way to glitchArr
+    std::vector<cl_event> pendingUploads; //uploadBuffer's writes, their host data stays untouched until finishUploads
 
-        queueProperties = 0;
-        queue = clCreateCommandQueueWithProperties(context, device, &queueProperties, &err);
-        d_readPixelArr = clCreateBuffer(context, CL_MEM_READ_ONLY, width * height * sizeof(uint32_t), NULL, &err);
-        d_writePixelArr = clCreateBuffer(context, CL_MEM_WRITE_ONLY, width * height * sizeof(uint32_t), NULL, &err);
+    fractal(int newWidth, int newHeight, cl_context context, cl_device_id device) {
+        width = newWidth;
+        height = newHeight;
+        glitchArr = new int[width * height];
 
-        err = clEnqueueWriteBuffer(queue, d_readPixelArr, CL_TRUE, 0, width * height * sizeof(uint32_t), readPixelArr, 0, NULL, NULL);
-        err = clEnqueueWriteBuffer(queue, d_writePixelArr, CL_TRUE, 0, width * height * sizeof(uint32_t), writePixelArr, 0, NULL, NULL);
+        globalWorkSize = 6400;
+        localWorkSize = 64;
 
-        for (int i = 0; i < width * height; ++i) {
-            workQueue[i] = i;
+        stateIterations = 0;
+        memset(panView, 0, sizeof(panView)); //nothing rendered to pan from yet
+        previewing = false;
+        previewZoom = 0;
+        if (context == NULL) { //CPU renderer, no device resources
+            gBufferArr = new gBufferPixel[width * height];
+            previousGBufferArr = new gBufferPixel[width * height];
+            iterationCountArr = new int[width * height];
+            if (continueIterations) { pixelStateArr = new pixelState[width * height]; }
+            return;
         }
 
-        globalWorkSize = 6400;
-        localWorkSize = NULL;
-        d_workQueue = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(int) * width * height, workQueue, &err);
-        globalIndex = 0;
-        d_globalIndex = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(int), &globalIndex, &err);
+        createQueue(context, device);
+        cancelQueue = clCreateCommandQueueWithProperties(context, device, NULL, &err);
+        // in host memory, so mapping a finished frame for publishFrames copies nothing on integrated GPUs; two slots more than
+        // frames in flight, for the frame the mailbox holds and the one being shown
+        frameRing.resize((std::max)(frameRingDepth, 1) + 2);
+        for (frameSlot& slot : frameRing) {
+            slot.d_pixelArr = clCreateBuffer(context, CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY | CL_MEM_ALLOC_HOST_PTR, width * height * sizeof(uint32_t), NULL, &err);
+        }
+        nextFrame = framesInFlight = 0;
+
+        d_globalIndex = clCreateBuffer(context, CL_MEM_READ_WRITE, 2 * sizeof(int), NULL, &err);
+        const int zero = 0;
+        err = clEnqueueFillBuffer(queue, d_globalIndex, &zero, sizeof(int), 0, 2 * sizeof(int), 0, NULL, NULL);
+        createCancelGeneration(context, device);
+        d_interiorCounts = clCreateBuffer(context, CL_MEM_READ_WRITE, 2 * sizeof(int), NULL, &err);
+        d_gBuffer = clCreateBuffer(context, CL_MEM_READ_WRITE, width * height * sizeof(gBufferPixel), NULL, &err);
+        d_previousGBuffer = clCreateBuffer(context, CL_MEM_READ_WRITE, width * height * sizeof(gBufferPixel), NULL, &err);
+        d_palette = clCreateBuffer(context, CL_MEM_READ_ONLY, paletteSize * sizeof(uint32_t), NULL, &err);
+        paletteVersion = -1;
+        d_iterationCounts = clCreateBuffer(context, CL_MEM_READ_WRITE, width * height * sizeof(int), NULL, &err);
+        // a split rectangle is at least marianiSilverSplitSize / 2 on each side, so no list ever holds more than this
+        size_t rectListSize = (width * height / 16 + 4) * sizeof(cl_int4);
+        d_rectLists[0] = clCreateBuffer(context, CL_MEM_READ_WRITE, rectListSize, NULL, &err);
+        d_rectLists[1] = clCreateBuffer(context, CL_MEM_READ_WRITE, rectListSize, NULL, &err);
+        d_rectCounts = clCreateBuffer(context, CL_MEM_READ_WRITE, 2 * sizeof(int), NULL, &err);
+        d_iteratedPixels = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(int), NULL, &err);
+        d_skippedIterations = clCreateBuffer(context, CL_MEM_READ_WRITE, 2 * sizeof(cl_uint), NULL, &err);
+        d_glitchList = clCreateBuffer(context, CL_MEM_READ_WRITE, width * height * sizeof(int), NULL, &err);
+        d_glitchCount = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(int), NULL, &err);
+        d_escalatedTiles = clCreateBuffer(context, CL_MEM_READ_WRITE, (1 + tileCount()) * sizeof(int), NULL, &err);
+        if (continueIterations) {
+            d_pixelState = clCreateBuffer(context, CL_MEM_READ_WRITE, width * height * sizeof(pixelState), NULL, &err);
+        }
     }
 
     ~fractal() {
         // Release OpenCL resources
+        releaseFrameRing();
         if (queue) {
             clReleaseCommandQueue(queue);
         }
-        if (d_readPixelArr) {
-            clReleaseMemObject(d_readPixelArr);
-        }
-        if (d_writePixelArr) {
-            clReleaseMemObject(d_writePixelArr);
-        }
-        if (d_workQueue) {
-            clReleaseMemObject(d_workQueue);
+        if (cancelQueue) {
+            clReleaseCommandQueue(cancelQueue);
         }
         if (d_globalIndex) {
             clReleaseMemObject(d_globalIndex);
         }
-
-        // Release dynamically allocated arrays
-        delete[] writePixelArr;
-        delete[] readPixelArr;
-        delete[] workQueue;
-
-        // Release SDL resources
-        if (texture) {
-            SDL_DestroyTexture(texture);
+        releaseCancelGeneration();
+        if (d_interiorCounts) {
+            clReleaseMemObject(d_interiorCounts);
+        }
+        if (d_pixelState) {
+            clReleaseMemObject(d_pixelState);
+        }
+        if (d_gBuffer) {
+            clReleaseMemObject(d_gBuffer);
+        }
+        if (d_previousGBuffer) {
+            clReleaseMemObject(d_previousGBuffer);
         }
-        if (surface) {
-            SDL_FreeSurface(surface);
+        if (d_palette) {
+            clReleaseMemObject(d_palette);
         }
+        if (d_iterationCounts) {
+            clReleaseMemObject(d_iterationCounts);
+        }
+        for (cl_mem& list : d_rectLists) {
+            if (list) {
+                clReleaseMemObject(list);
+            }
+        }
+        if (d_rectCounts) {
+            clReleaseMemObject(d_rectCounts);
+        }
+        if (d_iteratedPixels) {
+            clReleaseMemObject(d_iteratedPixels);
+        }
+        if (d_referenceOrbit) {
+            clReleaseMemObject(d_referenceOrbit);
+        }
+        if (d_blaTable) {
+            clReleaseMemObject(d_blaTable);
+        }
+        if (d_skippedIterations) {
+            clReleaseMemObject(d_skippedIterations);
+        }
+        for (cl_mem buffer : { d_glitchOrbit, d_glitchTable, d_pixelList, d_glitchList, d_glitchCount, d_escalatedTiles }) {
+            if (buffer) {
+                clReleaseMemObject(buffer);
+            }
+        }
+
+        // Release dynamically allocated arrays
+        delete[] pixelStateArr;
+        delete[] gBufferArr;
+        delete[] previousGBufferArr;
+        delete[] iterationCountArr;
+        delete[] glitchArr;
     }
 
     /*void mapRGBReadPixelArr(uint32_t* pixelsToSet)
@@ -209,140 +402,1422 @@ public:
         }
     }*/
 
-    void writeBuffers() {
+    // Zeroes the pixel counter and the interior counters with device-side fills, so starting a frame costs no host transfer.
+    void resetGlobalIndex() {
+        const int zero = 0;
+        err = clEnqueueFillBuffer(queue, d_globalIndex, &zero, sizeof(int), 0, sizeof(int), 0, NULL, NULL);
+        if (err == CL_SUCCESS) {
+            err = clEnqueueFillBuffer(queue, d_interiorCounts, &zero, sizeof(int), 0, 2 * sizeof(int), 0, NULL, NULL);
+        }
+        if (err != CL_SUCCESS) {
+            std::cerr << "\n\nError: Failed to reset global index!\n\n" << std::endl;
+            exit(1);
+        }
+    }
+
+    // Copies the interior counters of the frame that was just rendered into interiorCounts.
+    void readInteriorCounts() {
+        if (queue == NULL) { //CPU renderer
+            interiorCounts[0] = cpuInteriorCounts[0];
+            interiorCounts[1] = cpuInteriorCounts[1];
+            return;
+        }
+        err = clEnqueueReadBuffer(queue, d_interiorCounts, CL_TRUE, 0, 2 * sizeof(int), interiorCounts, 0, NULL, NULL);
+    }
+
+    // Copies the number of pixels the frame that was just rendered actually iterated into iteratedPixels.
+    void readIteratedPixels() {
+        if (queue == NULL) { //CPU renderer
+            iteratedPixels = cpuIteratedPixels;
+            return;
+        }
+        err = clEnqueueReadBuffer(queue, d_iteratedPixels, CL_TRUE, 0, sizeof(int), &iteratedPixels, 0, NULL, NULL);
+    }
+
+    // Copies the number of iterations BLA steps skipped in the frame that was just rendered into skippedIterations.
+    void readSkippedIterations() {
+        if (queue == NULL) { //CPU renderer
+            skippedIterations = cpuSkippedIterations;
+            return;
+        }
+        cl_uint words[2] = { 0, 0 };
+        err = clEnqueueReadBuffer(queue, d_skippedIterations, CL_TRUE, 0, 2 * sizeof(cl_uint), words, 0, NULL, NULL);
+        skippedIterations = (long long)words[1] << 32 | words[0];
+    }
+
+    // Enqueues the Mariani-Silver passes of kernel (marianiSilverKernel) in place of the compute kernel; call after setKernelArgs.
+    // Each pass subdivides the rectangles the one before could not fill, until they are small enough to iterate in full. The
+    // rectangle lists and their lengths stay on the device, so the passes run back to back without a readback in between.
+    void enqueueMarianiSilver(cl_kernel& kernel) {
+        cl_int4 copyRect = { { cpuArgs.copyRect.x, cpuArgs.copyRect.y, cpuArgs.copyRect.width, cpuArgs.copyRect.height } };
+        int first = 9; //julia sets take c before copyRect
+        err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &d_gBuffer);
+        err = clSetKernelArg(kernel, 1, sizeof(int), &width);
+        err = clSetKernelArg(kernel, 2, sizeof(int), &height);
+        err = clSetKernelArg(kernel, 3, sizeof(double), &cpuArgs.zoom);
+        err = clSetKernelArg(kernel, 4, sizeof(double), &cpuArgs.positionX);
+        err = clSetKernelArg(kernel, 5, sizeof(double), &cpuArgs.positionY);
+        err = clSetKernelArg(kernel, 6, sizeof(int), &maxIterations);
+        err = clSetKernelArg(kernel, 7, sizeof(cl_mem), &d_globalIndex);
+        err = clSetKernelArg(kernel, 8, sizeof(cl_mem), &d_cancelGeneration);
+        if (cpuArgs.julia) {
+            err = clSetKernelArg(kernel, 9, sizeof(double), &cpuArgs.cX);
+            err = clSetKernelArg(kernel, 10, sizeof(double), &cpuArgs.cY);
+            first = 11;
+        }
+        err = clSetKernelArg(kernel, first, sizeof(cl_int4), &copyRect);
+        err = clSetKernelArg(kernel, first + 1, sizeof(double), &cpuArgs.cycleTolerance);
+        err = clSetKernelArg(kernel, first + 2, sizeof(cl_mem), &d_interiorCounts);
+        err = clSetKernelArg(kernel, first + 3, sizeof(cl_mem), &d_iterationCounts);
+        err = clSetKernelArg(kernel, first + 6, sizeof(cl_mem), &d_rectCounts);
+        err = clSetKernelArg(kernel, first + 7, sizeof(cl_mem), &d_iteratedPixels);
+        err = clSetKernelArg(kernel, first + 10, sizeof(int), &marianiSilverGuard);
+
+        const int zero = 0;
+        const int notIterated = -1;
+        resetGlobalIndex();
+        err = clEnqueueFillBuffer(queue, d_iterationCounts, &notIterated, sizeof(int), 0, width * height * sizeof(int), 0, NULL, NULL);
+        if (err == CL_SUCCESS) {
+            err = clEnqueueFillBuffer(queue, d_iteratedPixels, &zero, sizeof(int), 0, sizeof(int), 0, NULL, NULL);
+        }
 
-        err = clEnqueueWriteBuffer(queue, d_workQueue, CL_FALSE, 0, sizeof(int) * width * height, workQueue, 0, NULL, NULL);
+        int passes = 1;
+        for (int size = marianiSilverBlockSize; size > marianiSilverSplitSize; size /= 2) { passes++; }
+        for (int pass = 0; pass < passes && err == CL_SUCCESS; pass++) {
+            int lastPass = pass == passes - 1;
+            err = clSetKernelArg(kernel, first + 4, sizeof(cl_mem), &d_rectLists[pass & 1]);
+            err = clSetKernelArg(kernel, first + 5, sizeof(cl_mem), &d_rectLists[(pass + 1) & 1]);
+            err = clSetKernelArg(kernel, first + 8, sizeof(int), &pass);
+            err = clSetKernelArg(kernel, first + 9, sizeof(int), &lastPass);
+            if (err == CL_SUCCESS && pass > 0) {
+                err = clEnqueueFillBuffer(queue, d_globalIndex, &zero, sizeof(int), 0, sizeof(int), 0, NULL, NULL);
+            }
+            if (err == CL_SUCCESS) {
+                err = clEnqueueFillBuffer(queue, d_rectCounts, &zero, sizeof(int), ((pass + 1) & 1) * sizeof(int), sizeof(int), 0, NULL, NULL);
+            }
+            if (err == CL_SUCCESS) {
+                err = clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &globalWorkSize, &localWorkSize, 0, NULL, NULL);
+            }
+        }
         if (err != CL_SUCCESS) {
-            std::cerr << "\n\nError: Failed to write buffer!\n\n" << std::endl;
+            std::cerr << "\n\nError: Failed to enqueue the Mariani-Silver passes!\n\n" << std::endl;
             exit(1);
         }
-        globalIndex = 0;
-        err = clEnqueueWriteBuffer(queue, d_globalIndex, CL_FALSE, 0, sizeof(int), &globalIndex, 0, NULL, NULL);
+    }
+
+    // Picks how the next dispatch uses the per-pixel state: resume it if the view is unchanged and
+    // maxIterations has not gone down since it was written, otherwise start over and rewrite it.
+    void updateStateMode(double cX, double cY) {
+        // filled pixels have no state to resume, and a pan or a zoom preview would leave the state of every other pixel behind
+        if (!continueIterations || marianiSilver || panning || previewing || perturbation || escalating || (d_pixelState == NULL && pixelStateArr == NULL)) {
+            stateMode = stateNone;
+            stateIterations = 0;
+            return;
+        }
+        double view[5] = { (double)zoom, (double)position[0], (double)position[1], cX, cY };
+        bool sameView = stateIterations > 0 && maxIterations >= stateIterations && memcmp(view, stateView, sizeof(view)) == 0;
+        stateMode = sameView ? stateResume : stateWrite;
+        previousMaxIterations = stateIterations;
+        stateIterations = maxIterations;
+        memcpy(stateView, view, sizeof(view));
+    }
+
+    // Decides whether the next dispatch can reuse the G-buffer: if nothing but the position changed since it was
+    // rendered, and by less than a frame, the view is moved by the whole pixels in that change and panning is set.
+    // The sub-pixel remainder is kept for the next frame instead of being rendered.
+    void updatePan(double cX, double cY) {
+        if (previewing || perturbation || escalating) { //a rescaled preview is nothing to pan from, and deep positions are past double's shift arithmetic
+            panning = false;
+            memset(panView, 0, sizeof(panView));
+            return;
+        }
+        double view[7] = { (double)zoom, (double)maxIterations, cX, cY, (double)width, (double)height, (double)marianiSilver };
+        panning = incrementalPan && memcmp(view, panView, sizeof(view)) == 0;
+        memcpy(panView, view, sizeof(view));
+        if (!panning) { return; }
+
+        double pixelSize = (double)zoom / height;
+        double shiftX = trunc((cpuArgs.positionX - renderedPosition[0]) / pixelSize);
+        double shiftY = trunc((cpuArgs.positionY - renderedPosition[1]) / pixelSize);
+        if (!(fabs(shiftX) < width && fabs(shiftY) < height)) { //moved a whole frame, nothing to keep
+            panning = false;
+            return;
+        }
+        panShift[0] = (int)shiftX;
+        panShift[1] = (int)shiftY;
+        cpuArgs.positionX = renderedPosition[0] + shiftX * pixelSize;
+        cpuArgs.positionY = renderedPosition[1] + shiftY * pixelSize;
+    }
+
+    // Switches to perturbation once the pixel spacing is too fine for double pixel coordinates around the view, and brings
+    // the reference orbit up to date: the view centre becomes the reference point whenever the orbit no longer fits the view.
+    // The BLA table is rebuilt with the orbit, and when the frame's |dc| bound crosses a power of two. A tierEscalated
+    // frame needs the orbit too, for the tiles it escalates.
+    // Escalation is GPU only: detectCollapseKernel is the only collapse check, so the CPU renderer takes a tierEscalated
+    // frame whole in perturbation, and its float lanes (tierFloat, tierMixed) are never checked for collapse.
+    void updatePerturbation(double cX, double cY) {
+        floatExp pixelSize = zoom / height;
+        floatExp frameSize = zoom * width / height;
+        tier = precisionTier(cX, cY);
+        if (tier == tierEscalated && queue == NULL) { tier = tierPerturbation; }
+        perturbation = tier >= tierPerturbation;
+        escalating = tier == tierEscalated;
+        cpuArgs.floatRect = tier <= tierMixed ? floatRect(cX, cY) : pixelTile();
+        cpuSkippedIterations = 0;
+        cpuArgs.skippedIterations = &cpuSkippedIterations;
+        cpuArgs.pixelList = NULL;
+        cpuArgs.glitchList = fixGlitches ? glitchArr : NULL;
+        cpuGlitchCount = 0;
+        cpuArgs.glitchCount = &cpuGlitchCount;
+        if (!perturbation && !escalating) { return; }
+
+        finishUploads(); //the last frame's orbit and table may still be on their way
+        if (reference.update(position[0], position[1], pixelSize, frameSize, maxIterations, cpuArgs.julia, cX, cY)) {
+            referenceOnDevice = false;
+            bla.dcMax = -1;
+        }
+        // past what a double's exponent reaches the pixels work in units of the zoom's exponent
+        cpuArgs.scaleExponent = tier == tierExtended ? zoom.exponent : 0;
+        cpuArgs.frameZoom = zoom;
+        if (useReference(cpuArgs, reference, bla)) { blaOnDevice = false; }
+        if (queue == NULL) { return; } //CPU renderer reads the orbit and the table in place
+
+        if (!referenceOnDevice) {
+            uploadBuffer(d_referenceOrbit, referenceCapacity, reference.points.data(), reference.points.size() * sizeof(double));
+            referenceOnDevice = true;
+        }
+        if (cpuArgs.blaLevels > 0 && !blaOnDevice) {
+            uploadBuffer(d_blaTable, blaCapacity, bla.steps.data(), bla.steps.size() * sizeof(blaStep));
+            blaOnDevice = true;
+        }
+    }
+
+    // The cheapest precision that resolves the view: float where the pixels lie inside floatRect, double for the rest down to
+    // perturbationLimit, then perturbation, with the frame scaled once pixels are finer than a double's exponent reaches.
+    // While that limit falls inside the frame, tierEscalated leaves the tiles to detectCollapseKernel.
+    // Pick the compute kernel with this before setKernelArgs.
+    int precisionTier(double cX, double cY) const {
+        floatExp pixelSize = zoom / height;
+        double halfWidth = 0.5 * (double)(zoom * width / height);
+        double halfHeight = 0.5 * (double)zoom;
+        double largest = (std::max)(fabs((double)position[0]), fabs((double)position[1])) + (double)(zoom * width / height);
+        if (pixelSize < largest * perturbationLimit) {
+            if (pixelSize < floatExp(1.0, extendedRangeExponent)) { return tierExtended; }
+            // the frame's smallest largest coordinate, every pixel has one coordinate at least this far from 0
+            double smallest = (std::max)((std::max)(fabs((double)position[0]) - halfWidth, 0.0), (std::max)(fabs((double)position[1]) - halfHeight, 0.0));
+            return pixelSize < smallest * perturbationLimit ? tierPerturbation : tierEscalated;
+        }
+        pixelTile rect = floatRect(cX, cY);
+        if (rect.width == width && rect.height == height) { return tierFloat; }
+        return rect.width > 0 ? tierMixed : tierDouble;
+    }
+
+    // The pixels float resolves: those with both coordinates within the pixel spacing over floatLimit of 0, less a pixel of
+    // margin for rounding. Empty if julia sets' c is outside that square, which every orbit passes through.
+    pixelTile floatRect(double cX, double cY) const {
+        pixelTile rect;
+        double pixelSize = (double)zoom / height;
+        double radius = pixelSize / floatLimit;
+        if (!allowFloat || maxIterations >= (1 << 24) || (std::max)(fabs(cX), fabs(cY)) > radius) { return rect; } //CPU lanes count iterations in floats too
+        // pixel (x, y) is at position + ((x, y) - (width, height) / 2) * pixelSize
+        auto firstPixel = [&](double coordinate, int size) { return (int)(std::min)((std::max)(ceil((-radius - coordinate) / pixelSize + 0.5 * size) + 1, 0.0), (double)size); };
+        auto endPixel = [&](double coordinate, int size) { return (int)(std::min)((std::max)(floor((radius - coordinate) / pixelSize + 0.5 * size), 0.0), (double)size); };
+        rect.x = firstPixel((double)position[0], width);
+        rect.y = firstPixel((double)position[1], height);
+        rect.width = endPixel((double)position[0], width) - rect.x;
+        rect.height = endPixel((double)position[1], height) - rect.y;
+        if (rect.width <= 0 || rect.height <= 0) { rect = pixelTile(); }
+        return rect;
+    }
+
+    // Points args at orbit and its BLA table, rebuilding the table when the frame's |dc| bound around orbit crosses a power
+    // of two. Returns true if the table was rebuilt.
+    bool useReference(cpuKernelArgs& args, const referenceOrbit& orbit, blaTable& table) {
+        floatExp offsetX = (floatExp)(position[0] - orbit.real);
+        floatExp offsetY = (floatExp)(position[1] - orbit.imag);
+        args.referenceOrbit = orbit.points.data();
+        args.referenceLength = orbit.length();
+        args.offsetX = offsetX;
+        args.offsetY = offsetY;
+        args.referenceX = (double)orbit.real;
+        args.referenceY = (double)orbit.imag;
+
+        // julia sets have no dc, the mandelbrot set's reaches from the reference to the far corner of the frame
+        floatExp dcMax = 0;
+        if (!args.julia) { dcMax = floatExp(1.0, (int)ceil((hypot(offsetX, offsetY) + 0.5 * hypot(zoom * width / height, zoom)).log2())); }
+        bool rebuilt = useBla && (table.dcMax != dcMax || table.epsilon != blaEpsilon);
+        if (rebuilt) { table.build(orbit, dcMax, blaEpsilon); }
+        args.blaTable = table.steps.data();
+        args.blaLevels = useBla ? table.levels : 0;
+        return rebuilt;
+    }
+
+    // Enqueues a write of bytes of data to buffer, first replacing it with a larger one if it holds fewer than bytes
+    // (capacity). The write doesn't block the render thread, so data must stay as it is until finishUploads.
+    void uploadBuffer(cl_mem& buffer, size_t& capacity, const void* data, size_t bytes) {
+        if (bytes > capacity) {
+            if (buffer) { clReleaseMemObject(buffer); }
+            cl_context context;
+            clGetCommandQueueInfo(queue, CL_QUEUE_CONTEXT, sizeof(cl_context), &context, NULL);
+            buffer = clCreateBuffer(context, CL_MEM_READ_ONLY, bytes, NULL, &err);
+            capacity = bytes;
+        }
+        cl_event written = NULL;
+        err = clEnqueueWriteBuffer(queue, buffer, CL_FALSE, 0, bytes, data, 0, NULL, &written);
         if (err != CL_SUCCESS) {
-            std::cerr << "\n\nError: Failed to write buffer!\n\n" << std::endl;
+            std::cerr << "\n\nError: Failed to upload perturbation data!\n\n" << std::endl;
             exit(1);
         }
+        pendingUploads.push_back(written);
     }
 
-    void resize(int newWidth, int newHeight, SDL_Renderer* renderer, SDL_Window* window, cl_context context, cl_device_id device) {
-        // Release OpenCL resources
-        if (queue) {
-            clReleaseCommandQueue(queue);
+    // Waits for the writes uploadBuffer enqueued, after which their host data may change. Call before changing any of it:
+    // by then the in-order queue has nearly always run them, with the kernels that read them.
+    void finishUploads() {
+        if (pendingUploads.empty()) { return; }
+        err = clWaitForEvents((cl_uint)pendingUploads.size(), pendingUploads.data());
+        for (cl_event written : pendingUploads) { clReleaseEvent(written); }
+        pendingUploads.clear();
+    }
+
+    // Sets the arguments of kernel (perturbationKernel) for args, whose reference orbit and BLA table are on the device in
+    // orbit and table; pixelList holds args.pixelList, or is NULL to render the whole frame. tileList is d_escalatedTiles
+    // to render just the tiles in it.
+    void setPerturbationArgs(cl_kernel& kernel, const cpuKernelArgs& args, cl_mem orbit, cl_mem table, cl_mem pixelList, cl_mem tileList = NULL) {
+        int first = 7; //julia sets take c before the orbit
+        err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &d_gBuffer);
+        err = clSetKernelArg(kernel, 1, sizeof(int), &width);
+        err = clSetKernelArg(kernel, 2, sizeof(int), &height);
+        err = clSetKernelArg(kernel, 3, sizeof(floatExp), &args.frameZoom);
+        err = clSetKernelArg(kernel, 4, sizeof(int), &maxIterations);
+        err = clSetKernelArg(kernel, 5, sizeof(cl_mem), &d_globalIndex);
+        err = clSetKernelArg(kernel, 6, sizeof(cl_mem), &d_cancelGeneration);
+        if (args.julia) {
+            err = clSetKernelArg(kernel, 7, sizeof(double), &args.cX);
+            err = clSetKernelArg(kernel, 8, sizeof(double), &args.cY);
+            first = 9;
         }
-        if (d_readPixelArr) {
-            clReleaseMemObject(d_readPixelArr);
+        err = clSetKernelArg(kernel, first, sizeof(cl_mem), &orbit);
+        err = clSetKernelArg(kernel, first + 1, sizeof(int), &args.referenceLength);
+        err = clSetKernelArg(kernel, first + 2, sizeof(floatExp), &args.offsetX);
+        err = clSetKernelArg(kernel, first + 3, sizeof(floatExp), &args.offsetY);
+        if (!args.julia) {
+            err = clSetKernelArg(kernel, first + 4, sizeof(double), &args.referenceX);
+            err = clSetKernelArg(kernel, first + 5, sizeof(double), &args.referenceY);
         }
-        if (d_writePixelArr) {
-            clReleaseMemObject(d_writePixelArr);
+        cl_mem blaBuffer = args.blaLevels > 0 ? table : NULL;
+        cl_mem glitchBuffer = args.glitchList ? d_glitchList : NULL;
+        int blaArg = args.julia ? first + 4 : first + 6;
+        err = clSetKernelArg(kernel, blaArg, sizeof(cl_mem), &blaBuffer);
+        err = clSetKernelArg(kernel, blaArg + 1, sizeof(int), &args.blaLevels);
+        err = clSetKernelArg(kernel, blaArg + 2, sizeof(cl_mem), &d_skippedIterations);
+        err = clSetKernelArg(kernel, blaArg + 3, sizeof(int), &args.scaleExponent);
+        err = clSetKernelArg(kernel, blaArg + 4, sizeof(cl_mem), &pixelList);
+        err = clSetKernelArg(kernel, blaArg + 5, sizeof(int), &args.pixelCount);
+        err = clSetKernelArg(kernel, blaArg + 6, sizeof(cl_mem), &glitchBuffer);
+        err = clSetKernelArg(kernel, blaArg + 7, sizeof(cl_mem), &d_glitchCount);
+        err = clSetKernelArg(kernel, blaArg + 8, sizeof(cl_mem), &tileList);
+    }
+
+    // Enqueues a frame of tier tierMixed in place of the compute kernel: floatKernel, the compute kernel built with FLOAT_TIER,
+    // iterates the tiles inside floatRect and doubleKernel the rest. Call after setKernelArgs(doubleKernel) and
+    // setComputeKernelArgs(floatKernel).
+    void enqueueFloatTiles(cl_kernel& floatKernel, cl_kernel& doubleKernel) {
+        cl_int4 floatRect = { { cpuArgs.floatRect.x, cpuArgs.floatRect.y, cpuArgs.floatRect.width, cpuArgs.floatRect.height } };
+        const int zero = 0;
+        resetGlobalIndex();
+        err = clSetKernelArg(floatKernel, renderRectArg + 2, sizeof(cl_int4), &floatRect);
+        err = clSetKernelArg(doubleKernel, renderRectArg + 2, sizeof(cl_int4), &floatRect);
+        err = clEnqueueNDRangeKernel(queue, floatKernel, 1, NULL, &globalWorkSize, &localWorkSize, 0, NULL, NULL);
+        if (err == CL_SUCCESS) { //the double build claims the tiles from 0 again, the interior counts carry on
+            err = clEnqueueFillBuffer(queue, d_globalIndex, &zero, sizeof(int), 0, sizeof(int), 0, NULL, NULL);
         }
-        if (d_workQueue) {
-            clReleaseMemObject(d_workQueue);
+        if (err == CL_SUCCESS) {
+            err = clEnqueueNDRangeKernel(queue, doubleKernel, 1, NULL, &globalWorkSize, &localWorkSize, 0, NULL, NULL);
         }
-        if (d_globalIndex) {
-            clReleaseMemObject(d_globalIndex);
+        if (err != CL_SUCCESS) {
+            std::cerr << "\n\nError: Failed to enqueue the float and double tiles!\n\n" << std::endl;
+            exit(1);
         }
+    }
 
-        // Release dynamically allocated arrays
-        delete[] writePixelArr;
-        delete[] readPixelArr;
-        delete[] workQueue;
+    // Tiles of the frame as the kernels number them: 8x8 pixels (TILE_SIZE), in blocks of 8x8 tiles (SUPER_TILE).
+    size_t tileCount() const {
+        size_t blocksX = ((width + 7) / 8 + 7) / 8;
+        size_t blocksY = ((height + 7) / 8 + 7) / 8;
+        return blocksX * blocksY * 64;
+    }
 
-        // Release SDL resources
-        if (texture) {
-            SDL_DestroyTexture(texture);
+    // Enqueues detectKernel (detectCollapseKernel, of the build that just rendered the frame) to list the tiles it doesn't
+    // resolve in d_escalatedTiles; limit is its relative pixel spacing limit, 0 to leave that test out.
+    void enqueueDetection(cl_kernel& detectKernel, double limit) {
+        cl_int4 copyRect = { { cpuArgs.copyRect.x, cpuArgs.copyRect.y, cpuArgs.copyRect.width, cpuArgs.copyRect.height } };
+        cl_int4 floatRect = { { cpuArgs.floatRect.x, cpuArgs.floatRect.y, cpuArgs.floatRect.width, cpuArgs.floatRect.height } };
+        size_t tiles = tileCount();
+        const int zero = 0;
+        err = clSetKernelArg(detectKernel, 0, sizeof(cl_mem), &d_gBuffer);
+        err = clSetKernelArg(detectKernel, 1, sizeof(int), &width);
+        err = clSetKernelArg(detectKernel, 2, sizeof(int), &height);
+        err = clSetKernelArg(detectKernel, 3, sizeof(double), &cpuArgs.zoom);
+        err = clSetKernelArg(detectKernel, 4, sizeof(double), &cpuArgs.positionX);
+        err = clSetKernelArg(detectKernel, 5, sizeof(double), &cpuArgs.positionY);
+        err = clSetKernelArg(detectKernel, 6, sizeof(cl_int4), &copyRect);
+        err = clSetKernelArg(detectKernel, 7, sizeof(cl_int4), &floatRect);
+        err = clSetKernelArg(detectKernel, 8, sizeof(double), &limit);
+        err = clSetKernelArg(detectKernel, 9, sizeof(cl_mem), &d_escalatedTiles);
+        err = clEnqueueFillBuffer(queue, d_escalatedTiles, &zero, sizeof(int), 0, sizeof(int), 0, NULL, NULL);
+        if (err == CL_SUCCESS) {
+            err = clEnqueueNDRangeKernel(queue, detectKernel, 1, NULL, &tiles, &localWorkSize, 0, NULL, NULL);
         }
-        if (surface) {
-            SDL_FreeSurface(surface);
+        if (err == CL_SUCCESS) { //the next tier claims the listed tiles from 0
+            err = clEnqueueFillBuffer(queue, d_globalIndex, &zero, sizeof(int), 0, sizeof(int), 0, NULL, NULL);
         }
+        if (err != CL_SUCCESS) {
+            std::cerr << "\n\nError: Failed to enqueue the collapse detection!\n\n" << std::endl;
+            exit(1);
+        }
+    }
 
+    // Re-renders in doubleKernel the float tiles detectKernel (the float build's detectCollapseKernel) flags, after a frame
+    // of tierFloat or tierMixed; the list stays on the device. Needs tile claiming. Those tiles restart from iteration 0,
+    // resumed float state is no start for them.
+    void escalateToDouble(cl_kernel& detectKernel, cl_kernel& doubleKernel) {
+        if (tileClaiming != 1) { return; }
+        enqueueDetection(detectKernel, 0); //floatRect already keeps float within floatLimit
+        int escalatedState = stateMode == stateNone ? stateNone : stateWrite;
+        int stateModeArg = renderRectArg - 5;
+        err = clSetKernelArg(doubleKernel, stateModeArg, sizeof(int), &escalatedState);
+        err = clSetKernelArg(doubleKernel, renderRectArg + 3, sizeof(cl_mem), &d_escalatedTiles);
+        err = clEnqueueNDRangeKernel(queue, doubleKernel, 1, NULL, &globalWorkSize, &localWorkSize, 0, NULL, NULL);
+        if (err != CL_SUCCESS) {
+            std::cerr << "\n\nError: Failed to enqueue the escalated tiles!\n\n" << std::endl;
+            exit(1);
+        }
+        err = clSetKernelArg(doubleKernel, stateModeArg, sizeof(int), &stateMode);
+        err = clSetKernelArg(doubleKernel, renderRectArg + 3, sizeof(cl_mem), NULL);
+    }
 
-        width = newWidth;
-        height = newHeight;
-        writePixelArr = new uint32_t[width * height];
-        readPixelArr = new uint32_t[width * height];
-        workQueue = new int[width * height];
+    // Re-renders around the reference orbit, in perturbationKernel, the tiles of a tierEscalated frame that detectKernel (the
+    // double build's detectCollapseKernel) flags once the compute kernel has rendered it in double. With fixGlitches their
+    // glitched pixels go to the fix-up as enqueuePerturbation's do, and the frame is coloured once fixGlitchedPixels is done.
+    void escalateToPerturbation(cl_kernel& detectKernel, cl_kernel& perturbationKernel) {
+        enqueueDetection(detectKernel, perturbationLimit);
+        setPerturbationArgs(perturbationKernel, cpuArgs, d_referenceOrbit, d_blaTable, NULL, d_escalatedTiles);
+        const cl_uint zero = 0;
+        err = clEnqueueFillBuffer(queue, d_skippedIterations, &zero, sizeof(cl_uint), 0, 2 * sizeof(cl_uint), 0, NULL, NULL);
+        if (err == CL_SUCCESS) {
+            err = clEnqueueFillBuffer(queue, d_glitchCount, &zero, sizeof(cl_uint), 0, sizeof(cl_uint), 0, NULL, NULL);
+        }
+        if (err == CL_SUCCESS) {
+            err = clEnqueueNDRangeKernel(queue, perturbationKernel, 1, NULL, &globalWorkSize, &localWorkSize, 0, NULL, NULL);
+        }
+        if (err != CL_SUCCESS) {
+            std::cerr << "\n\nError: Failed to enqueue the escalated tiles!\n\n" << std::endl;
+            exit(1);
+        }
+        startGlitchFix();
+    }
 
-        surface = SDL_CreateRGBSurface(0, width, height, 32, rmask, gmask, bmask, amask);
-        if (surface == NULL)
-        {
-            printf("Surface could not be created! SDL_Error: %s\n", SDL_GetError());
+    // Enqueues kernel (perturbationKernel) in place of the compute kernel; call after setKernelArgs when perturbation is set.
+    // With fixGlitches the frame's glitch fix-up starts, and it is coloured only once fixGlitchedPixels has finished it.
+    void enqueuePerturbation(cl_kernel& kernel) {
+        setPerturbationArgs(kernel, cpuArgs, d_referenceOrbit, d_blaTable, NULL);
+        resetGlobalIndex();
+        const cl_uint zero = 0;
+        err = clEnqueueFillBuffer(queue, d_skippedIterations, &zero, sizeof(cl_uint), 0, 2 * sizeof(cl_uint), 0, NULL, NULL);
+        err = clEnqueueFillBuffer(queue, d_glitchCount, &zero, sizeof(cl_uint), 0, sizeof(cl_uint), 0, NULL, NULL);
+        err = clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &globalWorkSize, &localWorkSize, 0, NULL, NULL);
+        startGlitchFix();
+    }
+
+    // Same as enqueuePerturbation for the CPU renderer, which finishes the glitch fix-up straight away.
+    void renderPerturbation(cpuRenderer& engine) {
+        engine.renderPerturbation(cpuArgs);
+        startGlitchFix();
+        while (!fixGlitchedPixels(&engine, NULL)) {}
+    }
+
+    // Call after the perturbation pass is enqueued or rendered: with fixGlitches, the fix-up of its glitched pixels begins.
+    void startGlitchFix() {
+        referenceCount = 1;
+        reRenderedPixels = 0;
+        glitchLeftOver.clear();
+        fixingGlitches = fixGlitches;
+        if (fixingGlitches) { requestGlitches(); }
+    }
 
-            SDL_FreeSurface(surface);
-            SDL_DestroyRenderer(renderer);
-            SDL_DestroyWindow(window);
-            SDL_Quit();
+    // GPU path: enqueues the read of the glitch count the last pass left in d_glitchCount, without waiting for it. The
+    // list follows in readGlitches once the count has arrived.
+    void requestGlitches() {
+        if (queue == NULL) { return; } //CPU renderer
+        err = clEnqueueReadBuffer(queue, d_glitchCount, CL_FALSE, 0, sizeof(int), &glitchReadCount, 0, NULL, &glitchCountRead);
+        if (err != CL_SUCCESS) {
+            std::cerr << "\n\nError: Failed to read the glitched pixels!\n\n" << std::endl;
+            exit(1);
         }
-        texture = SDL_CreateTextureFromSurface(renderer, surface);
-        if (texture == NULL)
-        {
-            printf("Texture could not be created! SDL_Error: %s\n", SDL_GetError());
+        clFlush(queue);
+    }
+
+    // Whether the event has finished, or failed; never blocks.
+    static bool eventDone(cl_event event) {
+        cl_int status = CL_QUEUED;
+        cl_int result = clGetEventInfo(event, CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof(cl_int), &status, NULL);
+        return result != CL_SUCCESS || status <= CL_COMPLETE;
+    }
+
+    // Moves the readback requestGlitches started along without blocking: once the count has arrived, the read of that many
+    // pixels of d_glitchList into glitchArr is enqueued. Returns true and sets count once glitchArr holds the pixels the
+    // last pass flagged as glitched; the CPU renderer's are there as soon as it returns.
+    bool readGlitches(int& count) {
+        if (queue == NULL) { //CPU renderer
+            count = cpuGlitchCount;
+            return true;
+        }
+        if (glitchCountRead) {
+            if (!eventDone(glitchCountRead)) { return false; }
+            clReleaseEvent(glitchCountRead);
+            glitchCountRead = NULL;
+            if (glitchReadCount > 0) {
+                err = clEnqueueReadBuffer(queue, d_glitchList, CL_FALSE, 0, glitchReadCount * sizeof(int), glitchArr, 0, NULL, &glitchListRead);
+                if (err != CL_SUCCESS) {
+                    std::cerr << "\n\nError: Failed to read the glitched pixels!\n\n" << std::endl;
+                    exit(1);
+                }
+                clFlush(queue);
+            }
+        }
+        if (glitchListRead) {
+            if (!eventDone(glitchListRead)) { return false; }
+            clReleaseEvent(glitchListRead);
+            glitchListRead = NULL;
+        }
+        count = glitchReadCount;
+        return true;
+    }
+
+    // Splits the count pixels of glitchArr into 8-connected clusters, largest first. Each cluster is in scanline order,
+    // and clusters of one size are ordered by their first pixel, so the same frame always yields the same clusters.
+    std::vector<std::vector<int>> glitchClusters(int count) const {
+        std::vector<char> glitched(width * height, 0);
+        for (int i = 0; i < count; i++) { glitched[glitchArr[i]] = 1; }
+        std::vector<std::vector<int>> clusters;
+        for (int i = 0; i < count; i++) {
+            if (!glitched[glitchArr[i]]) { continue; } //already in a cluster
+            clusters.emplace_back(1, glitchArr[i]);
+            std::vector<int>& cluster = clusters.back();
+            glitched[glitchArr[i]] = 0;
+            // flood fill, with the cluster itself as the queue
+            for (size_t next = 0; next < cluster.size(); next++) {
+                int x = cluster[next] % width;
+                int y = cluster[next] / width;
+                for (int neighbourY = (std::max)(y - 1, 0); neighbourY <= (std::min)(y + 1, height - 1); neighbourY++) {
+                    for (int neighbourX = (std::max)(x - 1, 0); neighbourX <= (std::min)(x + 1, width - 1); neighbourX++) {
+                        int neighbour = neighbourY * width + neighbourX;
+                        if (glitched[neighbour]) {
+                            glitched[neighbour] = 0;
+                            cluster.push_back(neighbour);
+                        }
+                    }
+                }
+            }
+            std::sort(cluster.begin(), cluster.end());
+        }
+        std::sort(clusters.begin(), clusters.end(), [](const std::vector<int>& a, const std::vector<int>& b) {
+            return a.size() != b.size() ? a.size() > b.size() : a.front() < b.front();
+        });
+        return clusters;
+    }
 
-            SDL_DestroyTexture(texture);
-            SDL_FreeSurface(surface);
-            SDL_DestroyRenderer(renderer);
-            SDL_DestroyWindow(window);
-            SDL_Quit();
+    // The pixel of cluster farthest from its edge, by a two-pass chessboard distance transform over its bounding box; the
+    // first in scanline order of those tied. A reference there sits well inside the glitch, where a centroid may miss it.
+    int clusterCentre(const std::vector<int>& cluster) const {
+        int left = width, right = 0, top = height, bottom = 0;
+        for (int pixel : cluster) {
+            left = (std::min)(left, pixel % width);
+            right = (std::max)(right, pixel % width);
+            top = (std::min)(top, pixel / width);
+            bottom = (std::max)(bottom, pixel / width);
         }
+        // a one-pixel margin of 0 around the box, so the edges of the frame count as edges of the cluster
+        int boxWidth = right - left + 3;
+        int boxHeight = bottom - top + 3;
+        std::vector<int> distance(boxWidth * boxHeight, 0);
+        for (int pixel : cluster) { distance[(pixel / width - top + 1) * boxWidth + pixel % width - left + 1] = width + height; }
+        for (int y = 1; y < boxHeight - 1; y++) {
+            for (int x = 1; x < boxWidth - 1; x++) {
+                int& d = distance[y * boxWidth + x];
+                if (d == 0) { continue; }
+                const int* above = &distance[(y - 1) * boxWidth + x];
+                d = (std::min)(d, 1 + (std::min)((std::min)(above[-1], above[0]), (std::min)(above[1], distance[y * boxWidth + x - 1])));
+            }
+        }
+        int centre = cluster.front();
+        int deepest = 0;
+        for (int y = boxHeight - 2; y >= 1; y--) {
+            for (int x = boxWidth - 2; x >= 1; x--) {
+                int& d = distance[y * boxWidth + x];
+                if (d == 0) { continue; }
+                const int* below = &distance[(y + 1) * boxWidth + x];
+                d = (std::min)(d, 1 + (std::min)((std::min)(below[-1], below[0]), (std::min)(below[1], distance[y * boxWidth + x + 1])));
+                if (d >= deepest) { //>= so that the first in scanline order wins, this pass runs backwards
+                    deepest = d;
+                    centre = (y + top - 1) * width + x + left - 1;
+                }
+            }
+        }
+        return centre;
+    }
+
+    // Re-renders the pixels the perturbation pass flagged as glitched around extra reference points. Every cluster of
+    // them gets a reference orbit from its pixel deepest inside, and only the cluster's pixels are rendered again,
+    // flagging the ones still glitched for the next pass. The reference's own pixel can't glitch, so every cluster shrinks;
+    // the passes stop once no pixel is glitched or maxReferences orbits were used. A glitched pixel stops iterating where it
+    // was caught, so any left over are rendered once more around the main reference without the test, as they would be with
+    // fixGlitches off. Exactly one of engine (CPU renderer) and kernel (perturbationKernel) is set. The orbits are kept for
+    // the next frame, which reuses them while they land on the same pixels.
+    // Runs at most one pass per call and never waits for the device: until the last pass's glitches have been read back
+    // it returns false straight away, so the GPU path calls it once per render loop, like publishFrames. Returns true once
+    // the fix-up started by startGlitchFix is done and the frame can be coloured.
+    bool fixGlitchedPixels(cpuRenderer* engine, cl_kernel* kernel) {
+        if (!fixingGlitches) { return true; }
+        int count = 0;
+        if (!readGlitches(count)) { return false; }
+        finishUploads(); //the count came after the last pass, so this doesn't wait
+
+        // renders args.pixelList, whose reference orbit and BLA table are in orbit and table on the device
+        auto renderList = [&](const cpuKernelArgs& args, cl_mem orbit, cl_mem table) {
+            if (engine) {
+                engine->renderPerturbation(args);
+                return;
+            }
+            uploadBuffer(d_pixelList, pixelListCapacity, args.pixelList, args.pixelCount * sizeof(int));
+            setPerturbationArgs(*kernel, args, orbit, table, d_pixelList);
+            resetGlobalIndex();
+            err = clEnqueueNDRangeKernel(queue, *kernel, 1, NULL, &globalWorkSize, &localWorkSize, 0, NULL, NULL);
+        };
+        floatExp pixelSize = zoom / height;
+        double aspectRatio = (double)width / height;
+        if (count > 0 && referenceCount < maxReferences && !frameStale()) { //a frame about to be dropped needs no more references
+            glitchClusterLists = glitchClusters(count);
+            cpuGlitchCount = 0;
+            if (kernel) {
+                const int zero = 0;
+                err = clEnqueueFillBuffer(queue, d_glitchCount, &zero, sizeof(int), 0, sizeof(int), 0, NULL, NULL);
+            }
+            for (const std::vector<int>& cluster : glitchClusterLists) {
+                if (referenceCount >= maxReferences) {
+                    glitchLeftOver.insert(glitchLeftOver.end(), cluster.begin(), cluster.end());
+                    continue;
+                }
+                int pixel = clusterCentre(cluster);
+                fixedPoint x = position[0] + fixedPoint(zoom * floatExp(((double)(pixel % width) / width - 0.5) * aspectRatio));
+                fixedPoint y = position[1] + fixedPoint(zoom * floatExp((double)(pixel / width) / height - 0.5));
+                size_t index = referenceCount - 1;
+                if (glitchReferences.size() <= index) {
+                    glitchReferences.resize(index + 1);
+                    glitchTables.resize(index + 1);
+                }
+                referenceOrbit& orbit = glitchReferences[index];
+                blaTable& table = glitchTables[index];
+                if (orbit.update(x, y, pixelSize, pixelSize, maxIterations, cpuArgs.julia, cpuArgs.cX, cpuArgs.cY)) { table.dcMax = -1; }
+
+                cpuKernelArgs args = cpuArgs;
+                useReference(args, orbit, table);
+                args.pixelList = cluster.data();
+                args.pixelCount = (int)cluster.size();
+                if (kernel) {
+                    uploadBuffer(d_glitchOrbit, glitchOrbitCapacity, orbit.points.data(), orbit.points.size() * sizeof(double));
+                    if (args.blaLevels > 0) { uploadBuffer(d_glitchTable, glitchTableCapacity, table.steps.data(), table.steps.size() * sizeof(blaStep)); }
+                }
+                renderList(args, d_glitchOrbit, d_glitchTable);
+                referenceCount++;
+                reRenderedPixels += args.pixelCount;
+            }
+            requestGlitches();
+            return false;
+        }
+        fixingGlitches = false;
+        glitchLeftOver.insert(glitchLeftOver.end(), glitchArr, glitchArr + count);
+        if (glitchLeftOver.empty() || frameStale()) { return true; }
+
+        cpuKernelArgs args = cpuArgs;
+        args.glitchList = NULL;
+        args.pixelList = glitchLeftOver.data();
+        args.pixelCount = (int)glitchLeftOver.size();
+        renderList(args, d_referenceOrbit, d_blaTable);
+        reRenderedPixels += args.pixelCount;
+        return true;
+    }
+
+    // Decides whether the next dispatch only previews the view: while the zoom changes and nothing else does, the last
+    // full render is kept as the preview source and rescaled every frame instead of iterating. Once the view needs pixels
+    // outside the source, or would magnify it twice or more, zoomStep asks for a new source at exactly twice or half its
+    // zoom and position first; with an even frame size a quarter of its pixels land on the old source's grid and are reused.
+    // A change of more than one step, or of anything but the zoom, renders in full. The render after the zoom stops is full too.
+    void updatePreview(double cX, double cY) {
+        double view[8] = { (double)position[0], (double)position[1], (double)maxIterations, cX, cY, (double)width, (double)height, (double)marianiSilver };
+        bool onlyZoomed = (double)zoom != previousZoom && memcmp(view, previewView, sizeof(view)) == 0;
+        bool hadSource = previewing; //otherwise the G-buffer holds the last full render, at panView[0] and renderedPosition
+        previousZoom = (double)zoom;
+        memcpy(previewView, view, sizeof(view));
+        previewing = false;
+        zoomStep = 0;
+        if (!zoomPreview || perturbation || escalating || !onlyZoomed) { return; }
+
+        double ratio = (double)zoom / (hadSource ? previewZoom : panView[0]);
+        if (!(ratio > 0.25 && ratio <= 2)) { return; }
+        if (!hadSource) {
+            swapGBuffers();
+            previewZoom = panView[0];
+            previewPosition[0] = renderedPosition[0];
+            previewPosition[1] = renderedPosition[1];
+        }
+        previewing = true;
+        if (ratio > 1) { zoomStep = 1; }
+        else if (ratio <= 0.5) { zoomStep = -1; }
+        if (zoomStep != 0) {
+            previewZoom *= zoomStep > 0 ? 2 : 0.5;
+            cpuArgs.zoom = previewZoom;
+            cpuArgs.positionX = previewPosition[0];
+            cpuArgs.positionY = previewPosition[1];
+        }
+        double pixelSize = previewZoom / height;
+        previewScale = (double)zoom / previewZoom;
+        previewOffset[0] = ((double)position[0] - previewPosition[0]) / pixelSize;
+        previewOffset[1] = ((double)position[1] - previewPosition[1]) / pixelSize;
+    }
+
+    // Swaps d_gBuffer with d_previousGBuffer, and gBufferArr with previousGBufferArr for the CPU renderer.
+    void swapGBuffers() {
+        std::swap(d_gBuffer, d_previousGBuffer);
+        std::swap(gBufferArr, previousGBufferArr);
+        cpuArgs.gBuffer = gBufferArr;
+    }
+
+    void enqueueReproject(cl_kernel& reprojectKernel, double scale, double offsetX, double offsetY, int markReused) {
+        err = clSetKernelArg(reprojectKernel, 0, sizeof(cl_mem), &d_previousGBuffer);
+        err = clSetKernelArg(reprojectKernel, 1, sizeof(cl_mem), &d_gBuffer);
+        err = clSetKernelArg(reprojectKernel, 2, sizeof(cl_mem), &d_iterationCounts);
+        err = clSetKernelArg(reprojectKernel, 3, sizeof(int), &width);
+        err = clSetKernelArg(reprojectKernel, 4, sizeof(int), &height);
+        err = clSetKernelArg(reprojectKernel, 5, sizeof(double), &scale);
+        err = clSetKernelArg(reprojectKernel, 6, sizeof(double), &offsetX);
+        err = clSetKernelArg(reprojectKernel, 7, sizeof(double), &offsetY);
+        err = clSetKernelArg(reprojectKernel, 8, sizeof(int), &markReused);
+        err = clEnqueueNDRangeKernel(queue, reprojectKernel, 1, NULL, &globalWorkSize, &localWorkSize, 0, NULL, NULL);
+    }
+
+    // Enqueues a zoom preview in place of the compute kernel; call after setKernelArgs when previewing is set. A zoom step
+    // first has kernel render the new source into the G-buffer, skipping the pixels reprojectKernel copied from the old one,
+    // and swaps it in; then the source is rescaled to the current zoom.
+    void enqueuePreview(cl_kernel& kernel, cl_kernel& reprojectKernel) {
+        if (zoomStep != 0) {
+            enqueueReproject(reprojectKernel, zoomStep > 0 ? 2 : 0.5, 0, 0, 1);
+            err = clSetKernelArg(kernel, renderRectArg + 1, sizeof(cl_mem), &d_iterationCounts);
+            resetGlobalIndex();
+            err = clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &globalWorkSize, &localWorkSize, 0, NULL, NULL);
+            swapGBuffers();
+        }
+        enqueueReproject(reprojectKernel, previewScale, previewOffset[0], previewOffset[1], 0);
+    }
+
+    // Same as enqueuePreview for the CPU renderer.
+    void renderPreview(cpuRenderer& engine) {
+        if (zoomStep != 0) {
+            engine.reproject(cpuArgs, previousGBufferArr, zoomStep > 0 ? 2 : 0.5, 0, 0, true);
+            engine.render(cpuArgs);
+            swapGBuffers();
+        }
+        engine.reproject(cpuArgs, previousGBufferArr, previewScale, previewOffset[0], previewOffset[1], false);
+    }
+
+    // The pixels a pan by panShift exposes: a band of columns and a band of rows beside it.
+    int panStrips(pixelTile* strips) const {
+        int count = 0;
+        if (panShift[0] != 0) {
+            strips[count].x = panShift[0] > 0 ? width - panShift[0] : 0;
+            strips[count].y = 0;
+            strips[count].width = abs(panShift[0]);
+            strips[count].height = height;
+            count++;
+        }
+        if (panShift[1] != 0) {
+            strips[count].x = panShift[0] > 0 ? 0 : -panShift[0];
+            strips[count].y = panShift[1] > 0 ? height - panShift[1] : 0;
+            strips[count].width = width - abs(panShift[0]);
+            strips[count].height = abs(panShift[1]);
+            count++;
+        }
+        return count;
+    }
+
+    // Enqueues a pan in place of the compute kernel; call after setKernelArgs when panning is set. The last G-buffer is
+    // shifted by shiftKernel and kernel renders only the strips that scrolled in, nothing at all if the view moved by less than a pixel.
+    void enqueuePan(cl_kernel& kernel, cl_kernel& shiftKernel) {
+        if (panShift[0] == 0 && panShift[1] == 0) { return; }
+        swapGBuffers();
+        err = clSetKernelArg(shiftKernel, 0, sizeof(cl_mem), &d_previousGBuffer);
+        err = clSetKernelArg(shiftKernel, 1, sizeof(cl_mem), &d_gBuffer);
+        err = clSetKernelArg(shiftKernel, 2, sizeof(int), &width);
+        err = clSetKernelArg(shiftKernel, 3, sizeof(int), &height);
+        err = clSetKernelArg(shiftKernel, 4, sizeof(int), &panShift[0]);
+        err = clSetKernelArg(shiftKernel, 5, sizeof(int), &panShift[1]);
+        err = clEnqueueNDRangeKernel(queue, shiftKernel, 1, NULL, &globalWorkSize, &localWorkSize, 0, NULL, NULL);
+
+        err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &d_gBuffer);
+        pixelTile strips[2];
+        int stripCount = panStrips(strips);
+        for (int i = 0; i < stripCount; i++) {
+            cl_int4 renderRect = { { strips[i].x, strips[i].y, strips[i].width, strips[i].height } };
+            err = clSetKernelArg(kernel, renderRectArg, sizeof(cl_int4), &renderRect);
+            resetGlobalIndex();
+            err = clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &globalWorkSize, &localWorkSize, 0, NULL, NULL);
+        }
+    }
+
+    // Same as enqueuePan for the CPU renderer.
+    void renderPan(cpuRenderer& engine) {
+        if (panShift[0] == 0 && panShift[1] == 0) { return; }
+        engine.shift(cpuArgs, panShift[0], panShift[1]);
+        pixelTile strips[2];
+        int stripCount = panStrips(strips);
+        for (int i = 0; i < stripCount; i++) { engine.render(cpuArgs, strips[i]); }
+    }
+
+    // Where the next frame goes: frames.back(), sized for the view. Every pixel must be written before publishFrame.
+    uint32_t* nextFramePixels() {
+        finishedFrame& frame = frames.back();
+        frame.pixelArr.resize((size_t)width * height);
+        frame.width = width;
+        frame.height = height;
+        frame.tier = tier;
+        frame.pixels = frame.pixelArr.data();
+        return frame.pixelArr.data();
+    }
+
+    // Hands the frame written to nextFramePixels to the UI thread, replacing one it has not shown yet.
+    void publishFrame() { frames.publish(); }
+
+    // Takes the UI thread's latest view of this fractal, resizing first if the layout changed. A render or recolour the
+    // view asked for since the last one taken is a single frame; one that only previews a zoom renders a second, see
+    // updatePreview.
+    void takeView(const fractalView& view, cl_context context, cl_device_id device) {
+        if (view.width != width || view.height != height) {
+            resize(view.width, view.height, context, device);
+            framesToUpdate = 1;
+        }
+        int update = view.generation != generation ? 1 : framesToUpdate;
+        int colour = view.colourGeneration != colourGeneration ? 1 : framesToColour;
+        fractalView::operator=(view);
+        framesToUpdate = update;
+        framesToColour = colour;
+    }
+
+    // Nothing the next frame renders may build on the last one: no pan from its G-buffer, no zoom preview rescaling it and
+    // no resumed pixel state.
+    void forgetRenderedFrame() {
+        memset(panView, 0, sizeof(panView));
+        previewing = false; //and with panView[0] at 0, updatePreview finds no full render to take as the source either
+        stateIterations = 0;
+    }
+
+    // Whether a frame that can still be abandoned is in flight.
+    bool abandonableInFlight() const {
+        for (int i = 1; i <= framesInFlight; i++) {
+            if (frameRing[(nextFrame - i + frameRing.size()) % frameRing.size()].tag != INT_MAX) { return true; }
+        }
+        return false;
+    }
+
+    // Call first in setKernelArgs: a frame that builds on the last one must not follow a frame that may yet be abandoned
+    // with an incomplete G-buffer, so while one is in flight the next renders in full.
+    void beginFrame() {
+        if (abandonableInFlight()) { forgetRenderedFrame(); }
+    }
+
+    // Call last in setKernelArgs, once the view is worked out. A full render may be abandoned when the UI thread asks for
+    // a newer view before it finishes, both on the device and on the CPU. A pan, a zoom preview or a resumed render is
+    // cheap and the next frame builds on it, so it always finishes; so does the frame after one that was abandoned, so that
+    // a view that keeps changing still shows every other frame at worst.
+    void tagFrame() {
+        bool standalone = !panning && !previewing && stateMode != stateResume;
+        frameTag = standalone && !lastFrameAbandoned && !abandonableInFlight() ? generation : INT_MAX;
+        cpuArgs.latestGeneration = frameTag != INT_MAX ? &latestGeneration : NULL;
+        cpuArgs.generation = generation;
+        if (queue) { err = clEnqueueFillBuffer(queue, d_globalIndex, &frameTag, sizeof(int), sizeof(int), sizeof(int), 0, NULL, NULL); }
+    }
+
+    // Whether the frame being rendered may stop early because the UI thread has asked for a newer view.
+    bool frameStale() const {
+        return frameTag != INT_MAX && latestGeneration.load(std::memory_order_relaxed) != generation;
+    }
+
+    // CPU renderer: call after the compute passes. True if they were abandoned for a newer view, in which case the G-buffer
+    // is incomplete, so the frame is neither coloured nor built on.
+    bool frameAbandoned() {
+        lastFrameAbandoned = frameStale();
+        if (lastFrameAbandoned) {
+            forgetRenderedFrame();
+            framesToColour = 0; //the newer view renders before anything is coloured again
+        }
+        return lastFrameAbandoned;
+    }
+
+    // Passes the UI thread's newest generation on to the device in d_cancelGeneration, so that the compute kernels of
+    // abandonable frames rendering an older view stop claiming work. Call once per render loop. With SVM atomics it is an
+    // atomic store into the SVM under d_cancelGeneration, which the kernels load atomically at all-SVM-devices scope, so
+    // running ones are sure to see it. Otherwise it falls back to a fill from cancelQueue, and nothing makes that visible to
+    // a kernel already running: it may see it or not, and a kernel that doesn't just finishes its frame. Either way nothing
+    // orders it against queue: the value only grows, a frame of the newest view is never below it, and a write the kernels
+    // see late only cancels less. The buffer is its own, so the fill never lands next to the claim counter queue's kernels
+    // are incrementing. Frames tagged below it are dropped by publishFrames whether they stopped or not.
+    void cancelStaleFrames() {
+        int latest = latestGeneration.load();
+        if (cancelQueue == NULL || latest <= cancelledBelow) { return; }
+        cancelledBelow = latest;
+        if (cancelGenerationArr) {
+            cancelGenerationArr->store(cancelledBelow, std::memory_order_relaxed);
+            return;
+        }
+        err = clEnqueueFillBuffer(cancelQueue, d_cancelGeneration, &cancelledBelow, sizeof(int), 0, sizeof(int), 0, NULL, NULL);
+        clFlush(cancelQueue);
+    }
+
+    // Creates d_cancelGeneration with nothing cancelled, on fine-grained SVM with atomics where the device has them, see
+    // cancelStaleFrames. The kernels load it as an atomic_int, so the SVM holds a std::atomic<int> constructed in place.
+    void createCancelGeneration(cl_context context, cl_device_id device) {
+        static_assert(sizeof(std::atomic<int>) == sizeof(int), "the kernels' atomic_int must overlay std::atomic<int>");
+        cancelledBelow = 0;
+        void* svm = hasSvmAtomics(device) ? clSVMAlloc(context, CL_MEM_READ_WRITE | CL_MEM_SVM_FINE_GRAIN_BUFFER | CL_MEM_SVM_ATOMICS, sizeof(std::atomic<int>), 0) : NULL;
+        if (svm) { //the buffer uses the SVM as its storage, so kernel arguments stay as they are
+            cancelGenerationArr = new (svm) std::atomic<int>(cancelledBelow);
+            d_cancelGeneration = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizeof(int), svm, &err);
+        }
+        else {
+            d_cancelGeneration = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(int), &cancelledBelow, &err);
+        }
+    }
+
+    // Releases d_cancelGeneration and the SVM under it; the queues must have finished with it.
+    void releaseCancelGeneration() {
+        if (d_cancelGeneration == NULL) { return; }
+        cl_context context = NULL;
+        clGetMemObjectInfo(d_cancelGeneration, CL_MEM_CONTEXT, sizeof(cl_context), &context, NULL);
+        clReleaseMemObject(d_cancelGeneration);
+        if (cancelGenerationArr) {
+            cancelGenerationArr->~atomic();
+            clSVMFree(context, cancelGenerationArr);
+        }
+        d_cancelGeneration = NULL;
+        cancelGenerationArr = NULL;
+    }
+
+    // Creates queue, high priority for the active view and low for the other where the device takes priority hints, so
+    // that when both views are rendering the device works on the one the user is looking at first.
+    void createQueue(cl_context context, cl_device_id device) {
+        cl_queue_properties properties[3] = { 0, 0, 0 };
+        size_t extensionsSize = 0;
+        clGetDeviceInfo(device, CL_DEVICE_EXTENSIONS, 0, NULL, &extensionsSize);
+        std::string extensions(extensionsSize, '\0');
+        clGetDeviceInfo(device, CL_DEVICE_EXTENSIONS, extensionsSize, &extensions[0], NULL);
+        if (extensions.find("cl_khr_priority_hints") != std::string::npos) {
+            properties[0] = CL_QUEUE_PRIORITY_KHR;
+            properties[1] = activeView ? CL_QUEUE_PRIORITY_HIGH_KHR : CL_QUEUE_PRIORITY_LOW_KHR;
+        }
+        queue = clCreateCommandQueueWithProperties(context, device, properties, &err);
+        if (err != CL_SUCCESS) {
+            std::cerr << "\n\nError: Failed to create command queue!\n\n" << std::endl;
+            exit(1);
+        }
+    }
+
+    // Makes this the active view or not, recreating its queue at the matching priority once its frames in flight are
+    // published. The buffers belong to the context, so they carry over.
+    void setActive(bool active, cl_context context, cl_device_id device) {
+        if (active == activeView) { return; }
+        activeView = active;
+        if (queue == NULL) { return; } //CPU renderer
+        clFinish(queue);
+        publishFrames(); //everything in flight is finished, so this hands every slot back but the one with the UI thread
+        clFinish(queue);
+        clReleaseCommandQueue(queue);
+        createQueue(context, device);
+    }
 
-        queueProperties = 0;
-        queue = clCreateCommandQueueWithProperties(context, device, &queueProperties, &err);
-        d_readPixelArr = clCreateBuffer(context, CL_MEM_READ_ONLY, width * height * sizeof(uint32_t), NULL, &err);
-        d_writePixelArr = clCreateBuffer(context, CL_MEM_WRITE_ONLY, width * height * sizeof(uint32_t), NULL, &err);
+    // Makes room in frameRing for the next frame, blocking only while frameRingDepth frames are in flight: then it waits
+    // for the oldest frame and publishes it. Call before enqueueing the frame's kernels.
+    void waitForFrameSlot() {
+        if (framesInFlight >= (int)frameRing.size() - 2) {
+            frameSlot& oldest = frameRing[(nextFrame - framesInFlight + frameRing.size()) % frameRing.size()];
+            err = clWaitForEvents(1, &oldest.mapped);
+            publishFrames();
+        }
+        reclaimFrameSlot(frameRing[nextFrame]);
+    }
 
-        err = clEnqueueWriteBuffer(queue, d_readPixelArr, CL_TRUE, 0, width * height * sizeof(uint32_t), readPixelArr, 0, NULL, NULL);
-        err = clEnqueueWriteBuffer(queue, d_writePixelArr, CL_TRUE, 0, width * height * sizeof(uint32_t), writePixelArr, 0, NULL, NULL);
+    // Blocks until the oldest frame in flight has reached the host, if there is one. For when there is nothing to submit.
+    void waitForOldestFrame() {
+        if (framesInFlight == 0) { return; }
+        frameSlot& oldest = frameRing[(nextFrame - framesInFlight + frameRing.size()) % frameRing.size()];
+        err = clWaitForEvents(1, &oldest.mapped);
+    }
 
-        for (int i = 0; i < width * height; ++i) {
-            workQueue[i] = i;
+    // Enqueues the colour kernel into the next slot of frameRing and chains the slot's mapping after it, so that the
+    // frame reaches the host without the host waiting for it; publishFrames picks it up. Call after setColourKernelArgs.
+    void enqueueColour(cl_kernel& kernel) {
+        frameSlot& slot = frameRing[nextFrame];
+        slot.tag = frameTag; //a recolour shares the fate of the G-buffer it colours
+        cl_event coloured = NULL;
+        err = clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &globalWorkSize, &localWorkSize, 0, NULL, &coloured);
+        if (err == CL_SUCCESS) {
+            slot.pixelArr = (uint32_t*)clEnqueueMapBuffer(queue, slot.d_pixelArr, CL_FALSE, CL_MAP_READ, 0, width * height * sizeof(uint32_t), 1, &coloured, &slot.mapped, &err);
+            clReleaseEvent(coloured);
+        }
+        if (err != CL_SUCCESS) {
+            std::cerr << "\n\nError: Failed to enqueue the colour pass!\n\n" << std::endl;
+            exit(1);
+        }
+        clFlush(queue); //start it now, nothing waits on the queue any more
+        nextFrame = (nextFrame + 1) % (int)frameRing.size();
+        framesInFlight++;
+    }
+
+    // Publishes the newest frame that has reached the host, and hands its slot and any older finished ones back to the
+    // ring. Frames cancelStaleFrames cancelled may have stopped early and are dropped instead. Never blocks; call once per
+    // loop whether or not a frame was submitted.
+    void publishFrames() {
+        int newest = -1;
+        while (framesInFlight > 0) {
+            frameSlot& oldest = frameRing[(nextFrame - framesInFlight + frameRing.size()) % frameRing.size()];
+            cl_int status = CL_QUEUED;
+            err = clGetEventInfo(oldest.mapped, CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof(cl_int), &status, NULL);
+            if (err != CL_SUCCESS || status > CL_COMPLETE) { break; } //still on its way; a failed frame (negative status) is dropped like a finished one
+            framesInFlight--;
+            lastFrameAbandoned = oldest.tag < cancelledBelow;
+            if (lastFrameAbandoned) {
+                if (oldest.tag == frameTag) { forgetRenderedFrame(); } //nothing newer was set up yet, so nothing rendered over its G-buffer
+                releaseFrameSlot(oldest);
+                continue;
+            }
+            if (newest >= 0) { releaseFrameSlot(frameRing[newest]); }
+            newest = (int)(&oldest - frameRing.data());
         }
+        if (newest < 0) { return; }
+        frameSlot& slot = frameRing[newest];
+        if (slot.pixelArr == NULL) {
+            releaseFrameSlot(slot);
+            return;
+        }
+        // the UI thread reads the mapping itself, the slot is unmapped once it has been shown
+        reclaimFrameSlots();
+        finishedFrame& frame = frames.back();
+        frame.pixels = slot.pixelArr;
+        frame.width = width;
+        frame.height = height;
+        frame.tier = tier;
+        frame.shown = false;
+        slot.published = &frame;
+        publishFrame();
+        reclaimFrameSlots();
+    }
+
+    // Unmaps the published slots the UI thread is done with: their frame was shown, or the mailbox dropped it, which hands
+    // a frame the UI thread no longer reads back as frames.back().
+    void reclaimFrameSlots() {
+        for (frameSlot& slot : frameRing) {
+            if (slot.published && (slot.published->shown || slot.published == &frames.back())) { releaseFrameSlot(slot); }
+        }
+    }
+
+    // Waits for the UI thread to be done with slot's published frame, if it has one, and unmaps it. That is only ever a
+    // frame the mailbox still holds, which the UI thread takes and shows within one of its loops.
+    void reclaimFrameSlot(frameSlot& slot) {
+        while (slot.published && showing) {
+            reclaimFrameSlots();
+            if (slot.published) { std::this_thread::yield(); }
+        }
+        if (slot.published) { releaseFrameSlot(slot); } //the UI thread has stopped, nothing reads it any more
+    }
+
+    // Unmaps a finished frame's pixels, the colour kernel can write the slot again after that.
+    void releaseFrameSlot(frameSlot& slot) {
+        err = clEnqueueUnmapMemObject(queue, slot.d_pixelArr, slot.pixelArr, 0, NULL, NULL);
+        clReleaseEvent(slot.mapped);
+        slot.mapped = NULL;
+        slot.pixelArr = NULL;
+        slot.published = NULL;
+    }
+
+    // Waits out the frames in flight without publishing them and releases the ring, before resize or destruction.
+    void releaseFrameRing() {
+        if (queue == NULL) { return; }
+        clFinish(cancelQueue);
+        clFinish(queue);
+        finishUploads();
+        for (cl_event* read : { &glitchCountRead, &glitchListRead }) {
+            if (*read) { clReleaseEvent(*read); }
+            *read = NULL;
+        }
+        fixingGlitches = false; //its frame was never coloured, and the G-buffer goes with it
+        for (frameSlot& slot : frameRing) {
+            reclaimFrameSlot(slot); //the UI thread may still be reading a published one
+            if (slot.mapped) { releaseFrameSlot(slot); }
+        }
+        clFinish(queue);
+        for (frameSlot& slot : frameRing) {
+            if (slot.d_pixelArr) { clReleaseMemObject(slot.d_pixelArr); }
+        }
+        frameRing.clear();
+        nextFrame = framesInFlight = 0;
+    }
+
+    // Also uploads the palette's table whenever it has been rebaked since the last upload.
+    void setColourKernelArgs(cl_kernel& kernel, const colourPalette& palette) {
+        cpuColour.gBuffer = gBufferArr;
+        cpuColour.pixelArr = kernel == NULL ? nextFramePixels() : NULL; //the GPU path publishes its mapped frames in publishFrames
+        cpuColour.pixelCount = width * height;
+        cpuColour.colouringScheme = colouringScheme;
+        cpuColour.palette = palette.lut;
+        cpuColour.colourCycle = colourCycle;
+        cpuColour.lightAngle = lightAngle;
+        cpuColour.lightHeight = lightHeight;
+        if (kernel == NULL) { return; } //CPU renderer
+
+        err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &d_gBuffer);
+        err = clSetKernelArg(kernel, 1, sizeof(cl_mem), &frameRing[nextFrame].d_pixelArr);
+        err = clSetKernelArg(kernel, 2, sizeof(int), &cpuColour.pixelCount);
+        err = clSetKernelArg(kernel, 3, sizeof(int), &colouringScheme);
+        err = clSetKernelArg(kernel, 4, sizeof(double), &colourCycle);
+        err = clSetKernelArg(kernel, 5, sizeof(double), &lightAngle);
+        err = clSetKernelArg(kernel, 6, sizeof(double), &lightHeight);
+        err = clSetKernelArg(kernel, 7, sizeof(cl_mem), &d_palette);
+
+        if (paletteVersion != palette.version) {
+            err = clEnqueueWriteBuffer(queue, d_palette, CL_TRUE, 0, paletteSize * sizeof(uint32_t), palette.lut, 0, NULL, NULL);
+            if (err != CL_SUCCESS) {
+                std::cerr << "\n\nError: Failed to upload palette!\n\n" << std::endl;
+                exit(1);
+            }
+            paletteVersion = palette.version;
+        }
+    }
+
+    // If the symmetry axis (the real axis, or the origin when pointSymmetry is set) is on screen, snaps the
+    // rendered position to the half-pixel grid around it, a quarter of a pixel at most, so that mirrored
+    // pixels land exactly on pixels, and sets cpuArgs.copyRect to the pixels the mirror pass can fill in.
+    void updateSymmetry(bool pointSymmetry) {
+        cpuArgs.copyRect = pixelTile();
+        if (!useSymmetry) { return; }
+
+        // row y mirrors onto row mirrorY - y
+        double shiftY = cpuArgs.positionY * 2 * height / cpuArgs.zoom;
+        if (!(fabs(shiftY) < height)) { return; } //axis off screen
+        int mirrorY = height - (int)round(shiftY);
+        pixelTile rect;
+        rect.x = 0;
+        rect.width = width;
+        if (mirrorY < height) { //axis in the top half, mirror it onto the bottom half
+            rect.y = 0;
+            rect.height = (mirrorY + 1) / 2;
+        }
+        else {
+            rect.y = mirrorY / 2 + 1;
+            rect.height = height - rect.y;
+        }
+
+        int mirrorX = 0;
+        if (pointSymmetry) {
+            // column x mirrors onto column mirrorX - x
+            double shiftX = cpuArgs.positionX * 2 * width / (cpuArgs.zoom * width / height);
+            if (!(fabs(shiftX) < width)) { return; }
+            mirrorX = width - (int)round(shiftX);
+            rect.x = (std::max)(0, mirrorX - width + 1);
+            rect.width = (std::min)(width, mirrorX + 1) - rect.x;
+        }
+        if (rect.width <= 0 || rect.height <= 0) { return; }
+
+        if (pointSymmetry) { cpuArgs.positionX = (width - mirrorX) * (cpuArgs.zoom * width / height) / (2 * width); }
+        cpuArgs.positionY = (height - mirrorY) * cpuArgs.zoom / (2 * height);
+        cpuArgs.copyRect = rect;
+        cpuArgs.mirrorX = mirrorX;
+        cpuArgs.mirrorY = mirrorY;
+    }
+
+    bool hasMirror() const { return cpuArgs.copyRect.width > 0 && cpuArgs.copyRect.height > 0; }
+
+    // Call after setKernelArgs.
+    void setMirrorKernelArgs(cl_kernel& kernel) {
+        if (kernel == NULL) { return; } //CPU renderer
+        cl_int4 copyRect = { { cpuArgs.copyRect.x, cpuArgs.copyRect.y, cpuArgs.copyRect.width, cpuArgs.copyRect.height } };
+        err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &d_gBuffer);
+        err = clSetKernelArg(kernel, 1, sizeof(int), &width);
+        err = clSetKernelArg(kernel, 2, sizeof(cl_int4), &copyRect);
+        err = clSetKernelArg(kernel, 3, sizeof(int), &cpuArgs.mirrorX);
+        err = clSetKernelArg(kernel, 4, sizeof(int), &cpuArgs.mirrorY);
+    }
+
+    void resize(int newWidth, int newHeight, cl_context context, cl_device_id device) {
+        // Release OpenCL resources
+        releaseFrameRing();
+        if (queue) {
+            clReleaseCommandQueue(queue);
+        }
+        if (d_globalIndex) {
+            clReleaseMemObject(d_globalIndex);
+        }
+        releaseCancelGeneration();
+        if (d_interiorCounts) {
+            clReleaseMemObject(d_interiorCounts);
+        }
+        if (d_pixelState) {
+            clReleaseMemObject(d_pixelState);
+        }
+        if (d_gBuffer) {
+            clReleaseMemObject(d_gBuffer);
+        }
+        if (d_previousGBuffer) {
+            clReleaseMemObject(d_previousGBuffer);
+        }
+        if (d_palette) {
+            clReleaseMemObject(d_palette);
+        }
+        if (d_iterationCounts) {
+            clReleaseMemObject(d_iterationCounts);
+        }
+        for (cl_mem& list : d_rectLists) {
+            if (list) {
+                clReleaseMemObject(list);
+            }
+        }
+        if (d_rectCounts) {
+            clReleaseMemObject(d_rectCounts);
+        }
+        if (d_iteratedPixels) {
+            clReleaseMemObject(d_iteratedPixels);
+        }
+        if (d_referenceOrbit) {
+            clReleaseMemObject(d_referenceOrbit);
+        }
+        if (d_blaTable) {
+            clReleaseMemObject(d_blaTable);
+        }
+        if (d_skippedIterations) {
+            clReleaseMemObject(d_skippedIterations);
+        }
+        for (cl_mem buffer : { d_glitchOrbit, d_glitchTable, d_pixelList, d_glitchList, d_glitchCount, d_escalatedTiles }) {
+            if (buffer) {
+                clReleaseMemObject(buffer);
+            }
+        }
+        queue = NULL;
+        d_globalIndex = d_interiorCounts = d_pixelState = d_gBuffer = d_palette = NULL;
+        d_iterationCounts = d_rectLists[0] = d_rectLists[1] = d_rectCounts = d_iteratedPixels = d_previousGBuffer = d_referenceOrbit = NULL;
+        d_blaTable = d_skippedIterations = d_glitchOrbit = d_glitchTable = d_pixelList = d_glitchList = d_glitchCount = d_escalatedTiles = NULL;
+        referenceCapacity = blaCapacity = glitchOrbitCapacity = glitchTableCapacity = pixelListCapacity = 0;
+        referenceOnDevice = blaOnDevice = false;
+
+        // Release dynamically allocated arrays
+        delete[] pixelStateArr;
+        delete[] gBufferArr;
+        delete[] previousGBufferArr;
+        delete[] iterationCountArr;
+        delete[] glitchArr;
+        pixelStateArr = NULL;
+        gBufferArr = NULL;
+        previousGBufferArr = NULL;
+        iterationCountArr = NULL;
+
+        width = newWidth;
+        height = newHeight;
+        glitchArr = new int[width * height];
 
         globalWorkSize = 6400;
-        localWorkSize = NULL;
-        d_workQueue = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(int) * width * height, workQueue, &err);
-        globalIndex = 0;
-        d_globalIndex = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(int), &globalIndex, &err);
+        localWorkSize = 64;
+
+        stateIterations = 0;
+        memset(panView, 0, sizeof(panView)); //nothing rendered to pan from yet
+        previewing = false;
+        previewZoom = 0;
+        if (context == NULL) { //CPU renderer, no device resources
+            gBufferArr = new gBufferPixel[width * height];
+            previousGBufferArr = new gBufferPixel[width * height];
+            iterationCountArr = new int[width * height];
+            if (continueIterations) { pixelStateArr = new pixelState[width * height]; }
+            return;
+        }
+
+        createQueue(context, device);
+        // in host memory, so mapping a finished frame for publishFrames copies nothing on integrated GPUs; two slots more than
+        // frames in flight, for the frame the mailbox holds and the one being shown
+        frameRing.resize((std::max)(frameRingDepth, 1) + 2);
+        for (frameSlot& slot : frameRing) {
+            slot.d_pixelArr = clCreateBuffer(context, CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY | CL_MEM_ALLOC_HOST_PTR, width * height * sizeof(uint32_t), NULL, &err);
+        }
+        nextFrame = framesInFlight = 0;
+
+        d_globalIndex = clCreateBuffer(context, CL_MEM_READ_WRITE, 2 * sizeof(int), NULL, &err);
+        const int zero = 0;
+        err = clEnqueueFillBuffer(queue, d_globalIndex, &zero, sizeof(int), 0, 2 * sizeof(int), 0, NULL, NULL);
+        createCancelGeneration(context, device);
+        d_interiorCounts = clCreateBuffer(context, CL_MEM_READ_WRITE, 2 * sizeof(int), NULL, &err);
+        d_gBuffer = clCreateBuffer(context, CL_MEM_READ_WRITE, width * height * sizeof(gBufferPixel), NULL, &err);
+        d_previousGBuffer = clCreateBuffer(context, CL_MEM_READ_WRITE, width * height * sizeof(gBufferPixel), NULL, &err);
+        d_palette = clCreateBuffer(context, CL_MEM_READ_ONLY, paletteSize * sizeof(uint32_t), NULL, &err);
+        paletteVersion = -1;
+        d_iterationCounts = clCreateBuffer(context, CL_MEM_READ_WRITE, width * height * sizeof(int), NULL, &err);
+        // a split rectangle is at least marianiSilverSplitSize / 2 on each side, so no list ever holds more than this
+        size_t rectListSize = (width * height / 16 + 4) * sizeof(cl_int4);
+        d_rectLists[0] = clCreateBuffer(context, CL_MEM_READ_WRITE, rectListSize, NULL, &err);
+        d_rectLists[1] = clCreateBuffer(context, CL_MEM_READ_WRITE, rectListSize, NULL, &err);
+        d_rectCounts = clCreateBuffer(context, CL_MEM_READ_WRITE, 2 * sizeof(int), NULL, &err);
+        d_iteratedPixels = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(int), NULL, &err);
+        d_skippedIterations = clCreateBuffer(context, CL_MEM_READ_WRITE, 2 * sizeof(cl_uint), NULL, &err);
+        d_glitchList = clCreateBuffer(context, CL_MEM_READ_WRITE, width * height * sizeof(int), NULL, &err);
+        d_glitchCount = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(int), NULL, &err);
+        d_escalatedTiles = clCreateBuffer(context, CL_MEM_READ_WRITE, (1 + tileCount()) * sizeof(int), NULL, &err);
+        if (continueIterations) {
+            d_pixelState = clCreateBuffer(context, CL_MEM_READ_WRITE, width * height * sizeof(pixelState), NULL, &err);
+        }
     }
 };
 
 struct mandelbrotSet : fractal {
-    mandelbrotSet(int newWidth, int newHeight, SDL_Renderer* renderer, SDL_Window* window, cl_context context, cl_device_id device)
-        : fractal(newWidth, newHeight, renderer, window, context, device) {
+    mandelbrotSet(int newWidth, int newHeight, cl_context context, cl_device_id device)
+        : fractal(newWidth, newHeight, context, device) {
         type = "mandelbrotSet";
+        renderRectArg = 16;
         framesToUpdate = 4;
     }
     void setKernelArgs(cl_kernel& kernel) {
-        err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &d_writePixelArr);
+        beginFrame();
+        cpuArgs.gBuffer = gBufferArr;
+        cpuArgs.screenWidth = width;
+        cpuArgs.screenHeight = height;
+        cpuArgs.zoom = (double)zoom;
+        cpuArgs.positionX = (double)position[0];
+        cpuArgs.positionY = (double)position[1];
+        cpuArgs.maxIterations = maxIterations;
+        cpuArgs.julia = false;
+        updatePerturbation(0, 0);
+        updatePreview(0, 0);
+        updatePan(0, 0);
+        if (panning || previewing || perturbation || escalating) { cpuArgs.copyRect = pixelTile(); } //positions off the half-pixel grid, and the strips are thin anyway
+        else { updateSymmetry(false); }
+        updateStateMode(0, 0);
+        renderedPosition[0] = cpuArgs.positionX;
+        renderedPosition[1] = cpuArgs.positionY;
+        cpuArgs.cycleTolerance = cycleTolerance * cpuArgs.zoom / height;
+        cpuInteriorCounts[0] = cpuInteriorCounts[1] = 0;
+        cpuArgs.interiorCounts = cpuInteriorCounts;
+        cpuIteratedPixels = 0;
+        cpuArgs.iteratedPixels = &cpuIteratedPixels;
+        cpuArgs.iterationCounts = marianiSilver && !panning ? iterationCountArr : NULL; //pan strips are iterated in full
+        if (previewing) { cpuArgs.iterationCounts = zoomStep != 0 ? iterationCountArr : NULL; } //a zoom step skips the reused pixels
+        cpuArgs.state = pixelStateArr;
+        cpuArgs.stateMode = stateMode;
+        cpuArgs.previousMaxIterations = previousMaxIterations;
+        tagFrame();
+        if (kernel == NULL) { return; } //CPU renderer
+        setComputeKernelArgs(kernel);
+    }
+
+    // The compute kernel's arguments for the view setKernelArgs worked out, for either build of it: the float build is
+    // only passed here when tier is tierFloat, enqueueFloatTiles sets floatRect for a mixed frame.
+    void setComputeKernelArgs(cl_kernel& kernel) {
+        err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &d_gBuffer);
         err = clSetKernelArg(kernel, 1, sizeof(int), &width);
         err = clSetKernelArg(kernel, 2, sizeof(int), &height);
-        err = clSetKernelArg(kernel, 3, sizeof(double), &zoom);
-        err = clSetKernelArg(kernel, 4, sizeof(double), &position[0]);
-        err = clSetKernelArg(kernel, 5, sizeof(double), &position[1]);
+        err = clSetKernelArg(kernel, 3, sizeof(double), &cpuArgs.zoom);
+        err = clSetKernelArg(kernel, 4, sizeof(double), &cpuArgs.positionX);
+        err = clSetKernelArg(kernel, 5, sizeof(double), &cpuArgs.positionY);
         err = clSetKernelArg(kernel, 6, sizeof(int), &maxIterations);
-        err = clSetKernelArg(kernel, 7, sizeof(cl_mem), &d_workQueue);
-        err = clSetKernelArg(kernel, 8, sizeof(cl_mem), &d_globalIndex);
-        err = clSetKernelArg(kernel, 9, sizeof(int), &colouringScheme);
+        err = clSetKernelArg(kernel, 7, sizeof(cl_mem), &d_globalIndex);
+        err = clSetKernelArg(kernel, 8, sizeof(cl_mem), &d_cancelGeneration);
+        err = clSetKernelArg(kernel, 9, sizeof(int), &tileClaiming);
+        err = clSetKernelArg(kernel, 10, sizeof(cl_mem), &d_pixelState);
+        err = clSetKernelArg(kernel, 11, sizeof(int), &stateMode);
+        err = clSetKernelArg(kernel, 12, sizeof(int), &previousMaxIterations);
+        cl_int4 copyRect = { { cpuArgs.copyRect.x, cpuArgs.copyRect.y, cpuArgs.copyRect.width, cpuArgs.copyRect.height } };
+        err = clSetKernelArg(kernel, 13, sizeof(cl_int4), &copyRect);
+        err = clSetKernelArg(kernel, 14, sizeof(double), &cpuArgs.cycleTolerance);
+        err = clSetKernelArg(kernel, 15, sizeof(cl_mem), &d_interiorCounts);
+        cl_int4 renderRect = { { 0, 0, width, height } };
+        err = clSetKernelArg(kernel, 16, sizeof(cl_int4), &renderRect);
+        err = clSetKernelArg(kernel, 17, sizeof(cl_mem), NULL); //no reused pixels
+        cl_int4 floatRect = tier == tierFloat ? cl_int4{ { 0, 0, width, height } } : cl_int4{ { 0, 0, 0, 0 } };
+        err = clSetKernelArg(kernel, 18, sizeof(cl_int4), &floatRect);
+        err = clSetKernelArg(kernel, 19, sizeof(cl_mem), NULL); //every tile
     }
 };
 
 struct juliaSet : fractal {
-    array<double, 2> index = { 0, 0 };
-    juliaSet(int newWidth, int newHeight, SDL_Renderer* renderer, SDL_Window* window, cl_context context, cl_device_id device)
-        : fractal(newWidth, newHeight, renderer, window, context, device) {
+    juliaSet(int newWidth, int newHeight, cl_context context, cl_device_id device)
+        : fractal(newWidth, newHeight, context, device) {
         type = "juliaSet";
+        renderRectArg = 18;
     }
     void setKernelArgs(cl_kernel& kernel) {
+        beginFrame();
+        cpuArgs.gBuffer = gBufferArr;
+        cpuArgs.screenWidth = width;
+        cpuArgs.screenHeight = height;
+        cpuArgs.zoom = (double)zoom;
+        cpuArgs.positionX = (double)position[0];
+        cpuArgs.positionY = (double)position[1];
+        cpuArgs.maxIterations = maxIterations;
+        cpuArgs.julia = true;
+        cpuArgs.cX = index[0];
+        cpuArgs.cY = index[1];
+        updatePerturbation(index[0], index[1]);
+        updatePreview(index[0], index[1]);
+        updatePan(index[0], index[1]);
+        if (panning || previewing || perturbation || escalating) { cpuArgs.copyRect = pixelTile(); }
+        else { updateSymmetry(true); }
+        updateStateMode(index[0], index[1]);
+        renderedPosition[0] = cpuArgs.positionX;
+        renderedPosition[1] = cpuArgs.positionY;
+        cpuArgs.cycleTolerance = cycleTolerance * cpuArgs.zoom / height;
+        cpuInteriorCounts[0] = cpuInteriorCounts[1] = 0;
+        cpuArgs.interiorCounts = cpuInteriorCounts;
+        cpuIteratedPixels = 0;
+        cpuArgs.iteratedPixels = &cpuIteratedPixels;
+        cpuArgs.iterationCounts = marianiSilver && !panning ? iterationCountArr : NULL; //pan strips are iterated in full
+        if (previewing) { cpuArgs.iterationCounts = zoomStep != 0 ? iterationCountArr : NULL; } //a zoom step skips the reused pixels
+        cpuArgs.state = pixelStateArr;
+        cpuArgs.stateMode = stateMode;
+        cpuArgs.previousMaxIterations = previousMaxIterations;
+        tagFrame();
+        if (kernel == NULL) { return; } //CPU renderer
+        setComputeKernelArgs(kernel);
+    }
 
-        err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &d_writePixelArr);
+    // The compute kernel's arguments for the view setKernelArgs worked out, for either build of it: the float build is
+    // only passed here when tier is tierFloat, enqueueFloatTiles sets floatRect for a mixed frame.
+    void setComputeKernelArgs(cl_kernel& kernel) {
+        err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &d_gBuffer);
         err = clSetKernelArg(kernel, 1, sizeof(int), &(width));
         err = clSetKernelArg(kernel, 2, sizeof(int), &(height));
-        err = clSetKernelArg(kernel, 3, sizeof(double), &zoom);
-        err = clSetKernelArg(kernel, 4, sizeof(double), &position[0]);
-        err = clSetKernelArg(kernel, 5, sizeof(double), &position[1]);
+        err = clSetKernelArg(kernel, 3, sizeof(double), &cpuArgs.zoom);
+        err = clSetKernelArg(kernel, 4, sizeof(double), &cpuArgs.positionX);
+        err = clSetKernelArg(kernel, 5, sizeof(double), &cpuArgs.positionY);
         err = clSetKernelArg(kernel, 6, sizeof(int), &maxIterations);
-        err = clSetKernelArg(kernel, 7, sizeof(cl_mem), &d_workQueue);
-        err = clSetKernelArg(kernel, 8, sizeof(cl_mem), &d_globalIndex);
-        err = clSetKernelArg(kernel, 9, sizeof(int), &colouringScheme);
+        err = clSetKernelArg(kernel, 7, sizeof(cl_mem), &d_globalIndex);
+        err = clSetKernelArg(kernel, 8, sizeof(cl_mem), &d_cancelGeneration);
+        err = clSetKernelArg(kernel, 9, sizeof(int), &tileClaiming);
         err = clSetKernelArg(kernel, 10, sizeof(double), &index[0]);
         err = clSetKernelArg(kernel, 11, sizeof(double), &index[1]);
+        err = clSetKernelArg(kernel, 12, sizeof(cl_mem), &d_pixelState);
+        err = clSetKernelArg(kernel, 13, sizeof(int), &stateMode);
+        err = clSetKernelArg(kernel, 14, sizeof(int), &previousMaxIterations);
+        cl_int4 copyRect = { { cpuArgs.copyRect.x, cpuArgs.copyRect.y, cpuArgs.copyRect.width, cpuArgs.copyRect.height } };
+        err = clSetKernelArg(kernel, 15, sizeof(cl_int4), &copyRect);
+        err = clSetKernelArg(kernel, 16, sizeof(double), &cpuArgs.cycleTolerance);
+        err = clSetKernelArg(kernel, 17, sizeof(cl_mem), &d_interiorCounts);
+        cl_int4 renderRect = { { 0, 0, width, height } };
+        err = clSetKernelArg(kernel, 18, sizeof(cl_int4), &renderRect);
+        err = clSetKernelArg(kernel, 19, sizeof(cl_mem), NULL); //no reused pixels
+        cl_int4 floatRect = tier == tierFloat ? cl_int4{ { 0, 0, width, height } } : cl_int4{ { 0, 0, 0, 0 } };
+        err = clSetKernelArg(kernel, 20, sizeof(cl_int4), &floatRect);
+        err = clSetKernelArg(kernel, 21, sizeof(cl_mem), NULL); //every tile
     }
 };
\ No newline at end of file
@@ -12,8 +12,12 @@ bool leftMouseButtonHeld = false;
 array<int, 2> mousePos = { 0, 0 };
 double spaceBarCoolDown = 0.5; // seconds
 double timeElapsedAtSpaceBar = 0;
+double timeElapsedAtPaletteKey = 0;
+double timeElapsedAtModeKey = 0;
+double colourCycleSpeed = 0.25; // palette periods per second
+double lightRotationSpeed = 90; // degrees per second
 
-bool handleInput(fractal& activeFractal, mandelbrotSet& mandelbrot, juliaSet& julia) { //returns true if program quit requested
+bool handleInput(fractalView& activeFractal, fractalView& mandelbrot, fractalView& julia, colourPalette& palette) { //returns true if program quit requested
     SDL_Event event;
     while (SDL_PollEvent(&event) != 0)
     {
@@ -47,12 +51,40 @@ bool handleInput(fractal& activeFractal, mandelbrotSet& mandelbrot, juliaSet& ju
     }
     if (activatedKeyCodesMap[SDLK_SPACE] && timeElapsed - timeElapsedAtSpaceBar > spaceBarCoolDown) {
         activeFractal.colouringScheme = (activeFractal.colouringScheme + 1) % 2;
+        julia.framesToColour = 4;
+        mandelbrot.framesToColour = 4;
+        timeElapsedAtSpaceBar = timeElapsed;
+    }
+    if (activatedKeyCodesMap[SDLK_p] && timeElapsed - timeElapsedAtPaletteKey > spaceBarCoolDown) {
+        palette.next();
+        julia.framesToColour = 4;
+        mandelbrot.framesToColour = 4;
+        timeElapsedAtPaletteKey = timeElapsed;
+    }
+    if (activatedKeyCodesMap[SDLK_c]) {
+        mandelbrot.colourCycle += colourCycleSpeed * deltaTime;
+        julia.colourCycle = mandelbrot.colourCycle;
+        julia.framesToColour = 4;
+        mandelbrot.framesToColour = 4;
+    }
+    if (activatedKeyCodesMap[SDLK_r]) {
+        mandelbrot.lightAngle = fmod(mandelbrot.lightAngle + lightRotationSpeed * deltaTime, 360);
+        julia.lightAngle = mandelbrot.lightAngle;
+        julia.framesToColour = 4;
+        mandelbrot.framesToColour = 4;
+    }
+
+    if (activatedKeyCodesMap[SDLK_m] && timeElapsed - timeElapsedAtModeKey > spaceBarCoolDown) {
+        mandelbrot.marianiSilver = !mandelbrot.marianiSilver;
+        julia.marianiSilver = mandelbrot.marianiSilver;
         julia.framesToUpdate = 4;
         mandelbrot.framesToUpdate = 4;
-        timeElapsedAtSpaceBar = timeElapsed;
+        timeElapsedAtModeKey = timeElapsed;
     }
 
-    if (pressedKeys > 0) { activeFractal.framesToUpdate = 4; }
+    // keys that only change colours go through the colour pass, not the iteration
+    int colourKeys = activatedKeyCodesMap[SDLK_SPACE] + activatedKeyCodesMap[SDLK_p] + activatedKeyCodesMap[SDLK_c] + activatedKeyCodesMap[SDLK_r];
+    if (pressedKeys > colourKeys) { activeFractal.framesToUpdate = 4; }
 
     if (leftMouseButtonHeld && activeFractal.type == "mandelbrotSet") {
         julia.framesToUpdate = 4;
@@ -65,8 +97,8 @@ bool handleInput(fractal& activeFractal, mandelbrotSet& mandelbrot, juliaSet& ju
             mousePos = newMouseState;
         }
 
-        julia.index[0] = ((double)(mousePos[0] - mandelbrotGap) / mandelbrot.width - 0.5) * mandelbrot.zoom * ((double)mandelbrot.width / mandelbrot.height) + mandelbrot.position[0];
-        julia.index[1] = ((double)(mousePos[1] - mandelbrotGap) / mandelbrot.height - 0.5) * mandelbrot.zoom + mandelbrot.position[1];
+        julia.index[0] = ((double)(mousePos[0] - mandelbrotGap) / mandelbrot.width - 0.5) * (double)mandelbrot.zoom * ((double)mandelbrot.width / mandelbrot.height) + (double)mandelbrot.position[0];
+        julia.index[1] = ((double)(mousePos[1] - mandelbrotGap) / mandelbrot.height - 0.5) * (double)mandelbrot.zoom + (double)mandelbrot.position[1];
 
         julia.position[0] = 0;
         julia.position[1] = 0;
@@ -0,0 +1,33 @@
+#pragma once
+
+// Hands values from one thread to another where only the newest one matters: the view snapshots the UI thread
+// sends the render thread and the frames the render thread sends back. Three slots, one the producer fills, one the
+// consumer reads and one in between, swapped with an atomic exchange so that neither side ever waits for the other.
+// A value the consumer has not taken by the time the next one is published is dropped.
+
+#include <atomic>
+
+template <typename T>
+struct mailbox {
+    T slots[3];
+
+    // Producer: the slot to fill, which holds whatever was in it last time; it is the producer's until publish.
+    T& back() { return slots[writing]; }
+
+    // Producer: hands back() over, replacing the value the consumer has not taken yet.
+    void publish() { writing = middle.exchange(writing | freshFlag, std::memory_order_acq_rel) & slotMask; }
+
+    // Consumer: the newest value, NULL if nothing was published since the last take. It stays valid until the next take.
+    T* take() {
+        if ((middle.load(std::memory_order_acquire) & freshFlag) == 0) { return NULL; }
+        reading = middle.exchange(reading, std::memory_order_acq_rel) & slotMask;
+        return &slots[reading];
+    }
+
+private:
+    static const int slotMask = 3;
+    static const int freshFlag = 4; //set in middle while it holds a value the consumer has not taken
+    std::atomic<int> middle{ 1 };
+    int writing = 0; //producer's slot
+    int reading = 2; //consumer's slot
+};
@@ -0,0 +1,110 @@
+#pragma once
+
+// Colour palettes baked into a lookup table for the colour pass. Entry i is the colour at
+// position i / paletteSize of one palette period, so the colour kernel only has to turn a
+// pixel's smooth iteration count into an index. The table is rebaked on the host only when the
+// selected palette changes; version tells the fractals when to upload it again.
+
+#include <cstdint>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+const int paletteSize = 1024; //entries per palette period, matches PALETTE_SIZE in the kernels
+
+// Packs a colour the way fractal::texture expects it, in pixelFormat.
+inline uint32_t packColour(int red, int green, int blue) {
+    return ((uint32_t)(255) << 24) | ((uint32_t)red << 16) | ((uint32_t)green << 8) | (uint32_t)blue;
+}
+
+struct gradient {
+    std::string name;
+    std::vector<uint32_t> stops; //evenly spaced over one period, the last blends back into the first
+};
+
+struct colourPalette {
+    std::vector<gradient> gradients; //gradients[0] is the built-in sine palette and has no stops
+    int selected = 0;
+    int version = 0; //bumped every time lut is rebaked
+    uint32_t lut[paletteSize];
+
+    colourPalette() {
+        gradient sine;
+        sine.name = "sine";
+        gradients.push_back(sine);
+        bake();
+    }
+
+    // Adds the gradients in filename, one per line: a name followed by hex RRGGBB stops.
+    // Blank lines and lines starting with // are skipped. A missing file leaves only the sine palette.
+    void load(const std::string& filename) {
+        std::ifstream file(filename);
+        if (!file.is_open()) {
+            std::cerr << "Warning: Failed to open palette file: " << filename << std::endl;
+            return;
+        }
+        std::string line;
+        while (std::getline(file, line)) {
+            std::istringstream words(line);
+            gradient loaded;
+            if (!(words >> loaded.name) || loaded.name.compare(0, 2, "//") == 0) { continue; }
+            std::string stop;
+            while (words >> stop) {
+                unsigned long rgb = std::strtoul(stop.c_str(), NULL, 16);
+                loaded.stops.push_back(packColour((rgb >> 16) & 0xFF, (rgb >> 8) & 0xFF, rgb & 0xFF));
+            }
+            if (loaded.stops.size() < 2) {
+                std::cerr << "Warning: Palette " << loaded.name << " needs at least two colours" << std::endl;
+                continue;
+            }
+            gradients.push_back(loaded);
+        }
+    }
+
+    void select(int index) {
+        selected = index % (int)gradients.size();
+        bake();
+    }
+
+    void next() { select(selected + 1); }
+
+    const std::string& name() const { return gradients[selected].name; }
+
+private:
+    // The colouring the kernels used before palettes were baked: three phase-shifted sines.
+    static int sineChannel(double position, int channel) {
+        return (int)round(127.5 * sin(2 * M_PI * position + channel * (2.0 / 3.0) * M_PI + 1) + 127.5);
+    }
+
+    void bake() {
+        const std::vector<uint32_t>& stops = gradients[selected].stops;
+        for (int i = 0; i < paletteSize; i++) {
+            double position = (i + 0.5) / paletteSize;
+            if (stops.empty()) {
+                // the same colours as the per-pixel palette the kernels used to evaluate
+                lut[i] = packColour(sineChannel(position, 2), sineChannel(position, 1), sineChannel(position, 0));
+                continue;
+            }
+            double scaled = position * stops.size();
+            int stop = (int)scaled;
+            double fraction = scaled - stop;
+            uint32_t from = stops[stop];
+            uint32_t to = stops[(stop + 1) % stops.size()];
+            uint32_t blended = (uint32_t)(255) << 24;
+            for (int shift = 0; shift < 24; shift += 8) {
+                double channel = (1 - fraction) * ((from >> shift) & 0xFF) + fraction * ((to >> shift) & 0xFF);
+                blended |= (uint32_t)round(channel) << shift;
+            }
+            lut[i] = blended;
+        }
+        version++;
+    }
+};
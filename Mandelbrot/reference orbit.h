@@ -0,0 +1,256 @@
+#pragma once
+
+// One orbit iterated in fixed point on the host, for perturbation rendering: the kernels iterate every
+// pixel as a small double offset from it, so deep views cost about as much per pixel as shallow ones.
+// Orbits that are slow to iterate are cached on disk, compressed to the iterations where iterating the
+// stored doubles themselves drifts away from the fixed-point orbit; everything in between is rebuilt from
+// the previous checkpoint when the cache is read.
+
+#include <vector>
+#include <cstdint>
+#include <cstdio>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include "fixed point.h"
+
+const double orbitCheckpointTolerance = 1.0 / (1ull << 48); //relative error of a rebuilt point before the next one is stored exactly
+const double orbitCacheSeconds = 1; //orbits that took at least this long to iterate are written to the cache
+const char* const orbitCachePath = "Resources/orbit "; //cache file names are this, the key's hash and ".cache"
+const uint32_t orbitCacheVersion = 2;
+
+struct orbitCheckpoint {
+    int iteration;
+    double real;
+    double imag;
+};
+
+struct referenceOrbit {
+    fixedPoint real; //reference point: c for the mandelbrot set, z0 for julia sets
+    fixedPoint imag;
+    bool julia = false;
+    double cX = 0; //julia sets' c
+    double cY = 0;
+    int limbs = 0; //precision the orbit was iterated with, 0 if there is no orbit
+    int maxIterations = 0;
+    std::vector<double> points; //Z_0, Z_1, ... as real and imaginary parts, complexDouble in the kernels
+    bool escaped = false; //the orbit left the bailout radius before maxIterations, so it is as long as it gets
+
+    int length() const { return (int)points.size() / 2; }
+
+    // Keeps the orbit while it still fits the view: the same fractal and julia index, enough precision for pixelSize,
+    // enough iterations and a reference point within a frame of (x, y). Otherwise iterates a new one from (x, y).
+    // Returns true if the orbit was recomputed.
+    bool update(const fixedPoint& x, const fixedPoint& y, const floatExp& pixelSize, const floatExp& frameSize, int newMaxIterations, bool newJulia, double newCX, double newCY) {
+        int newLimbs = fixedPoint::limbsFor(pixelSize);
+        bool keep = limbs > 0 && julia == newJulia && cX == newCX && cY == newCY && limbs >= newLimbs
+            && (maxIterations >= newMaxIterations || escaped)
+            && fabs((floatExp)(x - real)) < frameSize && fabs((floatExp)(y - imag)) < frameSize;
+        if (keep) { return false; }
+
+        real = x;
+        imag = y;
+        real.setPrecision(newLimbs);
+        imag.setPrecision(newLimbs);
+        julia = newJulia;
+        cX = newCX;
+        cY = newCY;
+        limbs = newLimbs;
+        maxIterations = newMaxIterations;
+        if (!load()) {
+            auto start = std::chrono::steady_clock::now();
+            compute();
+            if (std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() >= orbitCacheSeconds) { save(); }
+        }
+        return true;
+    }
+
+    void compute() {
+        fixedPoint zReal, zImag, cReal, cImag;
+        if (julia) {
+            zReal = real;
+            zImag = imag;
+            cReal = fixedPoint(cX);
+            cImag = fixedPoint(cY);
+        }
+        else {
+            cReal = real;
+            cImag = imag;
+        }
+        zReal.setPrecision(limbs);
+        zImag.setPrecision(limbs);
+        cReal.setPrecision(limbs);
+        cImag.setPrecision(limbs);
+
+        points.clear();
+        escaped = false;
+        fixedPoint real2, imag2, cross;
+        for (int iteration = 0; ; iteration++) {
+            double x = (double)zReal;
+            double y = (double)zImag;
+            points.push_back(x);
+            points.push_back(y);
+            if (x * x + y * y >= 8 * 8) { //same bailout as the kernels
+                escaped = true;
+                break;
+            }
+            if (iteration >= maxIterations) { break; }
+
+            // z = z^2 + c from three squares, which are cheaper than the products: 2 x y = (x + y)^2 - x^2 - y^2
+            fixedPoint::square(zReal, real2);
+            fixedPoint::square(zImag, imag2);
+            fixedPoint::add(zReal, zImag, false, cross);
+            fixedPoint::square(cross, cross);
+            fixedPoint::add(real2, imag2, true, zReal);
+            zReal += cReal;
+            fixedPoint::add(cross, real2, true, zImag);
+            zImag -= imag2;
+            zImag += cImag;
+        }
+    }
+
+    // Z_{n+1} from Z_n in doubles, the way compress and expand both rebuild the points between checkpoints
+    static void nextPoint(double& x, double& y, double cReal, double cImag) {
+        double xNew = x * x - y * y + cReal;
+        y = 2 * x * y + cImag;
+        x = xNew;
+    }
+
+    // The iterations whose point, iterated in doubles from the previous one, is off by more than
+    // orbitCheckpointTolerance relative to the orbit, with the exact point; the first point is always one.
+    std::vector<orbitCheckpoint> compress() const {
+        std::vector<orbitCheckpoint> checkpoints;
+        double cReal = julia ? cX : (double)real;
+        double cImag = julia ? cY : (double)imag;
+        double x = 0, y = 0;
+        for (int i = 0; i < length(); i++) {
+            double exactX = points[2 * i];
+            double exactY = points[2 * i + 1];
+            double errorX = x - exactX;
+            double errorY = y - exactY;
+            if (i == 0 || errorX * errorX + errorY * errorY > orbitCheckpointTolerance * orbitCheckpointTolerance * (exactX * exactX + exactY * exactY)) {
+                orbitCheckpoint checkpoint = { i, exactX, exactY };
+                checkpoints.push_back(checkpoint);
+                x = exactX;
+                y = exactY;
+            }
+            nextPoint(x, y, cReal, cImag);
+        }
+        return checkpoints;
+    }
+
+    // Rebuilds newLength points from checkpoints made by compress.
+    void expand(const std::vector<orbitCheckpoint>& checkpoints, int newLength) {
+        points.resize(2 * (size_t)newLength);
+        double cReal = julia ? cX : (double)real;
+        double cImag = julia ? cY : (double)imag;
+        double x = 0, y = 0;
+        size_t next = 0;
+        for (int i = 0; i < newLength; i++) {
+            if (next < checkpoints.size() && checkpoints[next].iteration == i) {
+                x = checkpoints[next].real;
+                y = checkpoints[next].imag;
+                next++;
+            }
+            points[2 * i] = x;
+            points[2 * i + 1] = y;
+            nextPoint(x, y, cReal, cImag);
+        }
+    }
+
+    // Everything that identifies the orbit of a reference point at a precision, whatever its maxIterations.
+    std::string cacheKey() const {
+        std::ostringstream key;
+        for (const fixedPoint* value : { &real, &imag }) {
+            key.write((const char*)&value->negative, sizeof(bool));
+            key.write((const char*)value->limb, value->limbs * sizeof(uint32_t));
+        }
+        key.write((const char*)&limbs, sizeof(int));
+        key.write((const char*)&julia, sizeof(bool));
+        key.write((const char*)&cX, sizeof(double));
+        key.write((const char*)&cY, sizeof(double));
+        return key.str();
+    }
+
+    // The cache file for key, named after its FNV-1a hash.
+    static std::string cachePath(const std::string& key) {
+        uint64_t hash = 14695981039346656037ull;
+        for (char byte : key) {
+            hash ^= (unsigned char)byte;
+            hash *= 1099511628211ull;
+        }
+        char hex[17];
+        snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)hash);
+        return std::string(orbitCachePath) + hex + ".cache";
+    }
+
+    // Writes the compressed orbit to its cache file. The file starts with everything that identifies the orbit, so a
+    // hash collision reads as a miss.
+    void save() const {
+        std::string key = cacheKey();
+        std::ofstream file(cachePath(key), std::ios::binary);
+        if (!file) { return; } //the cache is only an optimisation
+        std::vector<orbitCheckpoint> checkpoints = compress();
+        int pointCount = length();
+        uint64_t checkpointCount = checkpoints.size();
+        uint64_t keyBytes = key.size();
+        file.write((const char*)&orbitCacheVersion, sizeof(orbitCacheVersion));
+        file.write((const char*)&keyBytes, sizeof(uint64_t));
+        file.write(key.data(), key.size());
+        file.write((const char*)&maxIterations, sizeof(int));
+        file.write((const char*)&escaped, sizeof(bool));
+        file.write((const char*)&pointCount, sizeof(int));
+        file.write((const char*)&checkpointCount, sizeof(uint64_t));
+        // field by field, orbitCheckpoint's padding would put uninitialised bytes in the file
+        for (const orbitCheckpoint& checkpoint : checkpoints) {
+            file.write((const char*)&checkpoint.iteration, sizeof(int));
+            file.write((const char*)&checkpoint.real, sizeof(double));
+            file.write((const char*)&checkpoint.imag, sizeof(double));
+        }
+    }
+
+    // Reads the orbit from its cache file if there is one for the current point, precision and julia index, and it was
+    // iterated far enough for maxIterations. Returns true if the points were read.
+    bool load() {
+        std::string key = cacheKey();
+        std::ifstream file(cachePath(key), std::ios::binary);
+        if (!file) { return false; }
+        uint32_t version = 0;
+        uint64_t keyBytes = 0;
+        file.read((char*)&version, sizeof(version));
+        file.read((char*)&keyBytes, sizeof(uint64_t));
+        if (!file || version != orbitCacheVersion || keyBytes != key.size()) { return false; }
+        std::string storedKey(key.size(), '\0');
+        file.read(&storedKey[0], storedKey.size());
+        if (!file || storedKey != key) { return false; }
+
+        int storedMaxIterations = 0;
+        bool storedEscaped = false;
+        int pointCount = 0;
+        uint64_t checkpointCount = 0;
+        file.read((char*)&storedMaxIterations, sizeof(int));
+        file.read((char*)&storedEscaped, sizeof(bool));
+        file.read((char*)&pointCount, sizeof(int));
+        file.read((char*)&checkpointCount, sizeof(uint64_t));
+        if (!file || pointCount <= 0 || checkpointCount == 0 || checkpointCount > (uint64_t)pointCount) { return false; }
+        if (storedMaxIterations < maxIterations && !storedEscaped) { return false; } //too short, iterate it again
+        std::vector<orbitCheckpoint> checkpoints(checkpointCount);
+        for (orbitCheckpoint& checkpoint : checkpoints) {
+            file.read((char*)&checkpoint.iteration, sizeof(int));
+            file.read((char*)&checkpoint.real, sizeof(double));
+            file.read((char*)&checkpoint.imag, sizeof(double));
+        }
+        if (!file) { return false; }
+        // expand needs the first point stored and the rest in order within the orbit, anything else is a damaged file
+        if (checkpoints[0].iteration != 0) { return false; }
+        for (size_t i = 1; i < checkpoints.size(); i++) {
+            if (checkpoints[i].iteration <= checkpoints[i - 1].iteration || checkpoints[i].iteration >= pointCount) { return false; }
+        }
+
+        expand(checkpoints, pointCount);
+        maxIterations = storedMaxIterations;
+        escaped = storedEscaped;
+        return true;
+    }
+};
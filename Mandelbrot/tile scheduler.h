@@ -0,0 +1,196 @@
+#pragma once
+
+// Persistent, core-pinned worker pool for the CPU renderer. Each frame is split into tiles; every
+// worker starts on a contiguous slice of them and, once its slice runs dry, steals the back half
+// of another worker's remaining slice, so a few slow tiles (deep interior near the cardioid)
+// never leave the other cores waiting.
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <vector>
+#include <memory>
+#include <chrono>
+#ifdef _WIN32
+#include <Windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+struct workerStats {
+    long long tilesDone = 0;
+    long long tilesStolen = 0; //tiles taken from another worker's slice
+    double busyTime = 0; //seconds spent rendering tiles
+    double idleTime = 0; //seconds between running out of tiles and the end of the frame
+};
+
+class tileScheduler {
+public:
+    explicit tileScheduler(int threadCount = 0) {
+        if (threadCount <= 0) { threadCount = (int)std::thread::hardware_concurrency(); }
+        if (threadCount <= 0) { threadCount = 1; }
+        for (int i = 0; i < threadCount; i++) {
+            workers.push_back(std::unique_ptr<worker>(new worker()));
+        }
+        for (int i = 0; i < threadCount; i++) {
+            workers[i]->thread = std::thread(&tileScheduler::workerLoop, this, i);
+        }
+    }
+
+    ~tileScheduler() {
+        {
+            std::lock_guard<std::mutex> guard(jobLock);
+            stopping = true;
+        }
+        jobReady.notify_all();
+        for (auto& w : workers) {
+            w->thread.join();
+        }
+    }
+
+    tileScheduler(const tileScheduler&) = delete;
+    tileScheduler& operator=(const tileScheduler&) = delete;
+
+    int workerCount() const { return (int)workers.size(); }
+
+    // Calls renderTile(tile) once for every tile in [0, tileCount) across the pool and returns
+    // when all of them are done.
+    void run(int tileCount, const std::function<void(int)>& renderTile) {
+        if (tileCount <= 0) { return; }
+        int count = (int)workers.size();
+        for (int i = 0; i < count; i++) {
+            std::lock_guard<std::mutex> guard(workers[i]->lock);
+            workers[i]->begin = (int)((long long)tileCount * i / count);
+            workers[i]->end = (int)((long long)tileCount * (i + 1) / count);
+        }
+
+        std::unique_lock<std::mutex> guard(jobLock);
+        job = &renderTile;
+        busyWorkers = count;
+        generation++;
+        jobReady.notify_all();
+        jobDone.wait(guard, [this] { return busyWorkers == 0; });
+        job = NULL;
+
+        auto frameEnd = std::chrono::high_resolution_clock::now();
+        for (auto& w : workers) {
+            w->stats.idleTime += std::chrono::duration<double>(frameEnd - w->finishTime).count();
+        }
+    }
+
+    std::vector<workerStats> stats() const {
+        std::vector<workerStats> result;
+        for (auto& w : workers) { result.push_back(w->stats); }
+        return result;
+    }
+
+    void resetStats() {
+        for (auto& w : workers) { w->stats = workerStats(); }
+    }
+
+private:
+    struct worker {
+        std::thread thread;
+        std::mutex lock; //guards begin/end
+        int begin = 0;
+        int end = 0;
+        workerStats stats;
+        std::chrono::time_point<std::chrono::high_resolution_clock> finishTime;
+    };
+
+    std::vector<std::unique_ptr<worker>> workers;
+    std::mutex jobLock;
+    std::condition_variable jobReady;
+    std::condition_variable jobDone;
+    const std::function<void(int)>* job = NULL;
+    unsigned long long generation = 0;
+    int busyWorkers = 0;
+    bool stopping = false;
+
+    static void pinToCore(int core) {
+#ifdef _WIN32
+        // cores beyond 64 live in further processor groups
+        WORD groupCount = GetActiveProcessorGroupCount();
+        DWORD remaining = (DWORD)core;
+        for (WORD group = 0; group < groupCount; group++) {
+            DWORD groupSize = GetActiveProcessorCount(group);
+            if (remaining < groupSize) {
+                GROUP_AFFINITY affinity = {};
+                affinity.Group = group;
+                affinity.Mask = (KAFFINITY)1 << remaining;
+                SetThreadGroupAffinity(GetCurrentThread(), &affinity, NULL);
+                return;
+            }
+            remaining -= groupSize;
+        }
+#elif defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(core % CPU_SETSIZE, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+        (void)core;
+#endif
+    }
+
+    bool popLocal(worker& self, int& tile) {
+        std::lock_guard<std::mutex> guard(self.lock);
+        if (self.begin >= self.end) { return false; }
+        tile = self.begin++;
+        return true;
+    }
+
+    // Moves the back half of the first non-empty slice after `thief` into the thief's own slice.
+    bool steal(int thief) {
+        int count = (int)workers.size();
+        for (int offset = 1; offset < count; offset++) {
+            worker& victim = *workers[(thief + offset) % count];
+            int begin, end;
+            {
+                std::lock_guard<std::mutex> guard(victim.lock);
+                int remaining = victim.end - victim.begin;
+                if (remaining <= 0) { continue; }
+                begin = victim.end - (remaining + 1) / 2;
+                end = victim.end;
+                victim.end = begin;
+            }
+            worker& self = *workers[thief];
+            std::lock_guard<std::mutex> guard(self.lock);
+            self.begin = begin;
+            self.end = end;
+            self.stats.tilesStolen += end - begin;
+            return true;
+        }
+        return false;
+    }
+
+    void workerLoop(int index) {
+        pinToCore(index);
+        worker& self = *workers[index];
+        unsigned long long seenGeneration = 0;
+        while (true) {
+            const std::function<void(int)>* renderTile;
+            {
+                std::unique_lock<std::mutex> guard(jobLock);
+                jobReady.wait(guard, [&] { return stopping || generation != seenGeneration; });
+                if (stopping) { return; }
+                seenGeneration = generation;
+                renderTile = job;
+            }
+
+            int tile;
+            while (popLocal(self, tile) || (steal(index) && popLocal(self, tile))) {
+                auto tileStart = std::chrono::high_resolution_clock::now();
+                (*renderTile)(tile);
+                self.stats.busyTime += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - tileStart).count();
+                self.stats.tilesDone++;
+            }
+            self.finishTime = std::chrono::high_resolution_clock::now();
+
+            std::lock_guard<std::mutex> guard(jobLock);
+            if (--busyWorkers == 0) { jobDone.notify_one(); }
+        }
+    }
+};